@@ -0,0 +1,101 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__bag_library_H
+#define rqt_bag_player__bag_library_H
+
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+#include <QWidget>
+
+class QDoubleSpinBox;
+class QFileInfo;
+class QFileSystemWatcher;
+class QLabel;
+class QLineEdit;
+class QTreeWidget;
+
+namespace rqt_bag_player {
+
+// Walks directories in the background and stores per-bag metadata in SQLite.
+// Bags whose size and modification time are unchanged are not reopened.
+class BagIndexer : public QThread
+{
+    Q_OBJECT
+public:
+    BagIndexer(const QString& databaseName, QObject* parent = nullptr);
+    ~BagIndexer();
+
+    // index a directory, or a single bag if a file is given
+    void enqueue(const QString& path);
+    void stop();
+
+Q_SIGNALS:
+    void directoryFound(const QString& dir);
+    void indexed(const QString& fileName);
+
+protected:
+    virtual void run() override;
+
+private:
+    void scan(const QString& dir);
+    bool isIndexed(const QFileInfo& info);
+    void indexFile(const QString& fileName);
+
+    QString databaseName;
+    QString connectionName;
+    QMutex mutex;
+    QWaitCondition condition;
+    QStringList queue;
+    bool is_stopping;
+};
+
+// metadata of an indexed bag, read without opening the bag
+struct CachedBag
+{
+    double begin_time;
+    double end_time;
+    QList<QPair<QString, QString>> topics;
+};
+
+class BagLibrary : public QWidget
+{
+    Q_OBJECT
+public:
+    BagLibrary(QWidget* parent = nullptr);
+    ~BagLibrary();
+
+    void setRootDirectory(const QString& dir);
+    QString rootDirectory() const { return rootDir; }
+
+    static QString defaultDatabaseName();
+
+    // metadata of fileName if it is indexed and unchanged since
+    static bool cachedBag(const QString& fileName, CachedBag& bag, const QString& databaseName = defaultDatabaseName());
+
+Q_SIGNALS:
+    void bagActivated(const QString& fileName);
+
+private:
+    void browse();
+    void query();
+    void on_indexer_directoryFound(const QString& dir);
+
+    QString rootDir;
+    QString connectionName;
+    BagIndexer* indexer;
+    QFileSystemWatcher* watcher;
+    QLineEdit* topicLine;
+    QDoubleSpinBox* durationSpin;
+    QTreeWidget* resultTree;
+    QLabel* statusLabel;
+};
+
+}
+
+#endif // rqt_bag_player__bag_library_H
@@ -0,0 +1,153 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__bag_player_H
+#define rqt_bag_player__bag_player_H
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rqt_bag_player {
+
+class BagPlayer
+{
+public:
+    BagPlayer();
+    ~BagPlayer();
+
+    // open the bags as one merged timeline
+    bool open(const std::vector<std::string>& fileNames);
+
+    // take over bags that were opened already, e.g. by BagScanner
+    bool open(const std::vector<std::shared_ptr<rosbag::Bag>>& bags);
+    void close();
+
+    ros::Time beginTime() const { return begin_time; }
+    ros::Time endTime() const { return end_time; }
+
+    // file holding the given bag time, the last one starting before it
+    // when the files overlap, empty before the first file
+    std::string fileName(const ros::Time& time) const;
+
+    // shift the bag at index in the order given to open() by offset, so
+    // bags recorded on machines with different clocks play aligned,
+    // takes effect on the next play()
+    void setOffset(const size_t& index, const ros::Duration& offset);
+    ros::Duration offset(const size_t& index) const;
+
+    // offset that aligns the bag at index to the reference bag, estimated
+    // by cross-correlating the arrival times of a topic in both bags
+    ros::Duration estimateOffset(const size_t& index, const size_t& reference,
+        const std::string& topic, const double& maxOffset = 5.0) const;
+
+    // publish the topics of the bag at index under prefix, e.g. "/b" plays
+    // /camera as /b/camera, to compare two runs side by side
+    void setPrefix(const size_t& index, const std::string& prefix);
+
+    // topic names, with the prefixes applied, and datatypes of all opened bags
+    std::vector<std::pair<std::string, std::string>> topics() const;
+
+    void setRate(const double& rate);
+    void setLoop(const bool& on);
+    void setPublishClock(const bool& on);
+
+    // publish /clock at frequency Hz of wall time, following the playback
+    // schedule between messages, or with every message if not positive
+    void setClockFrequency(const double& frequency);
+
+    // shift the published clock by offset, the messages are not changed
+    void setClockOffset(const ros::Duration& offset);
+
+    // publish the wall time at which playback started, advanced by the
+    // played bag time, instead of the bag time, loops continue the clock
+    void setClockWallTime(const bool& on);
+
+    void setTopics(const std::vector<std::string>& topics);
+
+    // called on the playing thread after each published message with its
+    // aligned bag time and serialized size, must not block
+    void setPublishCallback(const std::function<void(const ros::Time&, const uint32_t&)>& callback);
+
+    // start publishing from the given offset in seconds from the begin time
+    void play(const double& start);
+    void stop();
+    bool isPlaying() const { return is_playing; }
+
+    // continue after the last published message
+    void resume();
+
+    // move to the given offset in seconds, playback continues there if it was running
+    void seek(const double& start);
+
+    // stop and publish the next count messages right away, returns the
+    // bag time of the last one
+    ros::Time step(const size_t& count);
+
+    // bag time of the last published message
+    ros::Time currentTime() const;
+
+private:
+    struct Segment
+    {
+        ros::Time begin_time;
+        ros::Time end_time;
+        std::string fileName;
+    };
+
+    struct ClockSchedule;
+
+    void run(const ros::Time& start, const size_t& count);
+    void runClock(ClockSchedule& schedule, const double& frequency);
+    void updateRange();
+    bool sleepUntil(const ros::WallTime& time, const std::atomic<bool>* is_done = nullptr);
+
+    ros::NodeHandle n;
+    std::vector<std::shared_ptr<rosbag::Bag>> bags;
+
+    // handles of this player for reading message data, opened when
+    // playback first reaches their bag
+    std::vector<std::shared_ptr<rosbag::Bag>> read_bags;
+    std::vector<Segment> segments;
+    std::vector<ros::Duration> offsets;
+    std::vector<std::string> prefixes;
+    std::map<std::string, ros::Publisher> publishers;
+    ros::Publisher clock_pub;
+    ros::Time begin_time;
+    ros::Time end_time;
+
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::string> play_topics;
+    std::function<void(const ros::Time&, const uint32_t&)> publish_callback;
+    double rate;
+    bool is_loop;
+    bool is_clock;
+    double clock_frequency;
+    ros::Duration clock_offset;
+    bool is_clock_wall_time;
+
+    std::thread thread;
+    std::atomic<bool> is_playing;
+    std::atomic<bool> is_stopping;
+    std::atomic<int64_t> current_time;
+    std::atomic<int64_t> next_time;
+
+    // messages at next_time published already, playback resumes after them
+    size_t next_skip;
+};
+
+}
+
+#endif // rqt_bag_player__bag_player_H
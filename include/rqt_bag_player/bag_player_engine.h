@@ -0,0 +1,156 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__bag_player_engine_H
+#define rqt_bag_player__bag_player_engine_H
+
+#include "rqt_bag_player/bag_player.h"
+#include "rqt_bag_player/process_supervisor.h"
+#include "rqt_bag_player/recorder.h"
+
+#include <ros/ros.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rqt_bag_player {
+
+// Playback, recording and export behind one thread-safe API, driven by
+// the plugin, the headless node and anything else linking the core library.
+// Calls are serialized, times are in seconds from the begin of the bags.
+class BagPlayerEngine
+{
+public:
+    struct Statistics
+    {
+        ros::Time time;
+        uint64_t messages;
+        uint64_t bytes;
+        double message_rate;
+        double bandwidth;
+    };
+
+    BagPlayerEngine();
+    ~BagPlayerEngine();
+
+    // files opened for fileName, the bags listed in a .bagset or all parts
+    // of a split recording fileName is one of, otherwise fileName itself
+    static std::vector<std::string> expandFiles(const std::string& fileName);
+
+    // open the files as one timeline, every topic is played until setTopics(),
+    // a single file is expanded with expandFiles()
+    bool load(const std::vector<std::string>& fileNames);
+
+    // take over bags that were opened already, e.g. by BagScanner
+    bool load(const std::vector<std::shared_ptr<rosbag::Bag>>& bags);
+    void close();
+    bool isLoaded() const;
+
+    std::vector<std::string> fileNames() const;
+    std::vector<std::pair<std::string, std::string>> topics() const;
+    ros::Time beginTime() const;
+    ros::Time endTime() const;
+    double duration() const;
+
+    // file being played at the current position
+    std::string currentFileName() const;
+
+    void setTopics(const std::vector<std::string>& topics);
+    void setRate(const double& rate);
+    double rate() const;
+    void setLoop(const bool& on);
+    void setPublishClock(const bool& on);
+
+    // /clock frequency in Hz, zero to publish with every message, offset
+    // in seconds and wall time mapping, see BagPlayer
+    void setClockFrequency(const double& frequency);
+    void setClockOffset(const double& offset);
+    void setClockWallTime(const bool& on);
+
+    // per-bag settings, see BagPlayer
+    void setOffset(const size_t& index, const double& offset);
+    double offset(const size_t& index) const;
+    double estimateOffset(const size_t& index, const size_t& reference, const std::string& topic) const;
+    void setPrefix(const size_t& index, const std::string& prefix);
+
+    // play from the current position
+    bool play();
+    void pause();
+    bool isPlaying() const;
+
+    // move to time, playback continues there if it was running
+    bool seek(const double& time);
+
+    // pause and publish the next count messages right away
+    bool step(const size_t& count);
+
+    // time of the last published message, in seconds and as bag time,
+    // the position is an atomic that can be polled from any thread
+    double position() const;
+    ros::Time currentTime() const;
+
+    // record topics with rosbag record into fileName, returns once the
+    // bag has been opened or after timeout seconds
+    bool startRecord(const std::string& fileName, const std::vector<std::string>& topics,
+        const std::vector<std::string>& options = std::vector<std::string>(),
+        const int& splitSize = 0, const double& timeout = 10.0);
+
+    // start a helper node, e.g. a republisher, stopped with the recorders
+    std::string startNode(const std::string& program, const std::vector<std::string>& arguments, const std::string& prefix);
+
+    // interrupt every recorder and return once their bags are closed, they
+    // are killed after timeout seconds, or after ten without waiting if
+    // timeout is not positive
+    bool stopRecord(const double& timeout = 10.0);
+    bool isRecording() const;
+
+    // write the topics of the opened bags into fileName with rosbag filter,
+    // one output per file for a bag set, waits for rosbag filter unless wait is false
+    bool exportBag(const std::string& fileName, const std::vector<std::string>& topics, const bool& wait = true);
+
+    // percentage of the exports started without waiting, negative once all have exited
+    double exportProgress() const;
+
+    // stop every export, a waiting exportBag returns false without
+    // starting the remaining files of a bag set
+    bool cancelExport();
+
+    // called on the playing thread, at most every period seconds, must not block
+    void setPositionCallback(const std::function<void(const double&)>& callback, const double& period = 0.1);
+    void setStatisticsCallback(const std::function<void(const Statistics&)>& callback, const double& period = 1.0);
+
+private:
+    void on_published(const ros::Time& time, const uint32_t& size);
+
+    mutable std::mutex mutex;
+    BagPlayer player;
+    Recorder recorder;
+    ProcessSupervisor exports;
+    std::vector<int> export_ids;
+    std::atomic<int> export_generation;
+    std::vector<std::string> files;
+    double play_rate;
+    std::atomic<int64_t> begin_nsec;
+    std::atomic<double> play_position;
+
+    std::mutex callback_mutex;
+    std::function<void(const double&)> position_callback;
+    std::function<void(const Statistics&)> statistics_callback;
+    double position_period;
+    double statistics_period;
+    ros::WallTime last_position;
+    ros::WallTime last_statistics;
+    Statistics statistics;
+    uint64_t last_messages;
+    uint64_t last_bytes;
+};
+
+}
+
+#endif // rqt_bag_player__bag_player_engine_H
@@ -0,0 +1,76 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__bag_registry_H
+#define rqt_bag_player__bag_registry_H
+
+#include <rosbag/bag.h>
+
+#include <QThreadPool>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rqt_bag_player {
+
+// Bags opened in this process, shared by every player, scanner and plugin
+// instance. A file is opened and its index read once while anyone holds
+// it. Message data is read through handles of their own, so players do
+// not contend for the file position and chunk buffer of one rosbag::Bag.
+class BagRegistry
+{
+public:
+    // begin, end and topics of a bag, read from its index once
+    struct Index
+    {
+        ros::Time begin_time;
+        ros::Time end_time;
+        std::vector<std::pair<std::string, std::string>> topics;
+    };
+
+    static BagRegistry& instance();
+
+    // the open bag of fileName, opened if nobody holds it or the file has
+    // changed since, throws rosbag::BagException
+    std::shared_ptr<rosbag::Bag> open(const std::string& fileName);
+
+    // index of a bag, cached while the bag is held
+    std::shared_ptr<const Index> index(const std::shared_ptr<rosbag::Bag>& bag);
+
+    // a new handle on the file of bag for reading message data,
+    // throws rosbag::BagException
+    std::shared_ptr<rosbag::Bag> openReader(const std::shared_ptr<rosbag::Bag>& bag);
+
+    // threads reading bag indexes, shared so several windows opening
+    // folders do not multiply the readers
+    QThreadPool* threadPool() { return &pool; }
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<rosbag::Bag> bag;
+        std::shared_ptr<const Index> index;
+        qint64 size;
+        qint64 mtime;
+    };
+
+    BagRegistry();
+    BagRegistry(const BagRegistry&) = delete;
+    BagRegistry& operator=(const BagRegistry&) = delete;
+
+    Entry* find(const std::shared_ptr<rosbag::Bag>& bag);
+    void removeExpired();
+
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    QThreadPool pool;
+};
+
+}
+
+#endif // rqt_bag_player__bag_registry_H
@@ -0,0 +1,76 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__bag_scanner_H
+#define rqt_bag_player__bag_scanner_H
+
+#include <rosbag/bag.h>
+
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rqt_bag_player {
+
+// Opens bags and reads their headers and indexes on the thread pool of the
+// BagRegistry. The opened bags are kept so the player does not read the
+// indexes again, and are shared with other scanners and players.
+class BagScanner : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result
+    {
+        std::shared_ptr<rosbag::Bag> bag;
+        ros::Time begin_time;
+        ros::Time end_time;
+        std::vector<std::pair<std::string, std::string>> topics;
+    };
+
+    BagScanner(QObject* parent = nullptr);
+    ~BagScanner();
+
+    // number of bags this scanner reads at the same time, the pool of the
+    // registry bounds all scanners of the process together
+    void setMaxConcurrency(const int& count);
+
+    // drop the previous scan and start reading the given files
+    void scan(const QStringList& fileNames);
+    void cancel();
+
+    // result of a scanned file, the bag is empty if it could not be opened
+    Result result(const QString& fileName) const;
+    bool isFinished() const;
+
+Q_SIGNALS:
+    void scanned(const QString& fileName, const int& done, const int& total);
+    void finished();
+
+private:
+    // called with the mutex held
+    void startNext();
+    void scanFile(const QString& fileName, const int& generation);
+
+    mutable QMutex mutex;
+    QWaitCondition condition;
+    std::map<QString, Result> results;
+    std::deque<QString> queue;
+    std::atomic<int> generation;
+    int total;
+    int pending;
+    int max_concurrency;
+};
+
+}
+
+#endif // rqt_bag_player__bag_scanner_H
@@ -0,0 +1,58 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__buffer_pool_H
+#define rqt_bag_player__buffer_pool_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rqt_bag_player {
+
+// Size-classed buffers carved out of large slabs. Released buffers go back
+// to the free list of their class, so a steady message stream stops
+// hitting malloc once the pool has warmed up.
+class BufferPool
+{
+public:
+    struct Deleter
+    {
+        void operator()(uint8_t* data) const;
+    };
+    typedef std::unique_ptr<uint8_t[], Deleter> BufferPtr;
+
+    BufferPool();
+    ~BufferPool();
+
+    // buffers must be released before the pool is destroyed
+    BufferPtr allocate(const size_t& size);
+
+    // usable size of a buffer returned by allocate()
+    static size_t capacity(const uint8_t* data);
+
+    // bytes held in slabs, in use or free
+    size_t reservedBytes() const;
+
+private:
+    struct Header;
+    struct SizeClass
+    {
+        std::mutex mutex;
+        Header* free_list;
+        std::vector<std::unique_ptr<uint8_t[]>> slabs;
+    };
+
+    void release(Header* header);
+    void grow(const int& index);
+
+    static const int NumClasses = 19;
+    SizeClass classes[NumClasses];
+};
+
+}
+
+#endif // rqt_bag_player__buffer_pool_H
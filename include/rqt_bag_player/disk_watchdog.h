@@ -0,0 +1,61 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__disk_watchdog_H
+#define rqt_bag_player__disk_watchdog_H
+
+#include <QObject>
+#include <QString>
+
+class QTimer;
+
+namespace rqt_bag_player {
+
+class DiskWatchdog : public QObject
+{
+    Q_OBJECT
+public:
+    DiskWatchdog(QObject* parent = nullptr);
+
+    // minimum free space in bytes before thresholdCrossed() is emitted
+    void setThreshold(const qint64& bytes) { threshold = bytes; }
+
+    // watch the filesystem of dir while files beginning with baseName are written
+    void start(const QString& dir, const QString& baseName);
+    void stop();
+
+    qint64 freeSpace() const { return free_space; }
+    double writeRate() const { return write_rate; }
+
+    // estimated seconds left before the threshold is reached, negative if unknown
+    double remainingTime() const;
+
+    // delete the oldest closed split of the current recording
+    bool removeOldestFile();
+
+    static qint64 freeSpace(const QString& dir);
+
+Q_SIGNALS:
+    void statusChanged(const QString& message);
+    void thresholdCrossed();
+
+private:
+    void on_timer_timeout();
+    qint64 writtenBytes() const;
+
+    QTimer* timer;
+    QString dir;
+    QString baseName;
+
+    qint64 threshold;
+    qint64 free_space;
+    qint64 last_bytes;
+    qint64 last_msecs;
+    double write_rate;
+    bool is_crossed;
+};
+
+}
+
+#endif // rqt_bag_player__disk_watchdog_H
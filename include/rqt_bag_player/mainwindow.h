@@ -6,6 +6,7 @@
 #define rqt_bag_player__mainwindow_H
 
 #include <QMainWindow>
+#include <QVariantMap>
 
 namespace rqt_bag_player {
 
@@ -16,6 +17,18 @@ public:
     MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
 
+    // opened bags, selections and options, as stored in a perspective
+    QVariantMap saveSettings() const;
+    void restoreSettings(const QVariantMap& settings);
+
+    // namespace of the control services, set before the window is shown,
+    // every instance in a node needs its own
+    void setServiceNamespace(const QString& ns);
+
+    // stop playback, recorders, helper processes and subscriptions, the
+    // recorders are given a few seconds to close their bags
+    void shutdown();
+
 private:
     class Impl;
     Impl* impl;
@@ -9,6 +9,8 @@
 
 namespace rqt_bag_player {
 
+class MainWindow;
+
 class MyPlugin : public rqt_gui_cpp::Plugin
 {
     Q_OBJECT
@@ -22,6 +24,9 @@ public:
     // Comment in to signal that the plugin has a way to configure it
     // virtual bool hasConfiguration() const override;
     // virtual void triggerConfiguration() override;
+
+private:
+    MainWindow* widget_;
 };
 
 } // namespace
@@ -0,0 +1,97 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__process_supervisor_H
+#define rqt_bag_player__process_supervisor_H
+
+#include <QObject>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+class QProcess;
+
+namespace rqt_bag_player {
+
+// Starts external tools such as rosbag and rosrun as child processes and
+// keeps their handles. The processes live on a thread of their own, so
+// their output is drained and their exit collected without an event loop
+// in the calling thread. The thread starts with the first call. Every
+// child leads its own process group, which is signalled as a whole, so
+// children still running when the supervisor is destroyed are stopped
+// together with anything they started, none are left behind.
+class ProcessSupervisor : public QObject
+{
+    Q_OBJECT
+public:
+    ProcessSupervisor(QObject* parent = nullptr);
+    ~ProcessSupervisor();
+
+    // start program and read progress from its output with pattern, whose
+    // first capture is a percentage, returns the process id or -1
+    int start(const QString& program, const QStringList& arguments,
+        const QRegularExpression& progressPattern = QRegularExpression("(\\d+(?:\\.\\d+)?)%"));
+
+    // send SIGINT like Ctrl-C to the process group and SIGKILL if any of
+    // it is still running after timeout seconds, returns at once
+    void interrupt(const int& id, const double& timeout = 5.0);
+    void interruptAll(const double& timeout = 5.0);
+
+    // interrupt and wait until exited, returns false if it had to be killed
+    bool stop(const int& id, const double& timeout = 5.0);
+    bool stopAll(const double& timeout = 5.0);
+
+    // wait until the process has exited, forever if timeout is negative
+    bool wait(const int& id, const double& timeout = -1.0);
+
+    bool isRunning(const int& id) const;
+    bool hasRunning() const;
+
+    // exit code of an exited process, -1 if it is running, crashed or was killed
+    int exitCode(const int& id) const;
+
+    // last percentage read from the output, negative if none yet
+    double progress(const int& id) const;
+
+    // forget exited processes
+    void clearFinished();
+
+Q_SIGNALS:
+    // emitted on the supervisor's thread
+    void progressChanged(const int& id, const double& progress);
+    void finished(const int& id, const int& exitCode);
+
+private:
+    struct Process
+    {
+        QProcess* process;
+        QRegularExpression pattern;
+        QString output;
+        double progress;
+        int exit_code;
+        bool is_running;
+        bool is_killed;
+    };
+
+    std::vector<int> runningIds() const;
+    void call(const std::function<void()>& function) const;
+    void readOutput(const int& id);
+    bool waitFor(const std::vector<int>& ids, const double& timeout);
+
+    mutable QThread worker;
+    mutable std::once_flag worker_started;
+    QObject* context;
+    std::map<int, Process> processes;
+    int next_id;
+};
+
+}
+
+#endif // rqt_bag_player__process_supervisor_H
@@ -0,0 +1,55 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__recorder_H
+#define rqt_bag_player__recorder_H
+
+#include "rqt_bag_player/process_supervisor.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+namespace rqt_bag_player {
+
+// Starts rosbag record and its helper nodes as supervised child processes
+// and shuts them down together.
+class Recorder
+{
+public:
+    Recorder();
+
+    // record topics into fileName, split into parts of splitSize
+    // megabytes if positive, returns false if rosbag could not be started
+    bool record(const QString& fileName, const QStringList& topics, const QStringList& options, const int& splitSize = 0);
+
+    // start a helper node, e.g. a republisher feeding a recorder,
+    // returns the node name given with __name or an empty string
+    QString startNode(const QString& program, const QStringList& arguments, const QString& prefix);
+
+    // interrupt all started nodes, rosbag record closes its bags on SIGINT,
+    // nodes still running after timeout seconds are killed, waits for them
+    // to exit unless wait is false, returns false if one had to be killed
+    bool stop(const double& timeout = 10.0, const bool& wait = true);
+
+    bool isRunning() const { return processes.hasRunning(); }
+
+    // bags given to record() since the last stop()
+    QStringList bags() const { return fileNames; }
+
+    // wait until rosbag record has opened, or closed, every bag, an open
+    // bag is written as <name>.bag.active or <name>_<n>.bag.active, a
+    // timeout of 0 checks once
+    static bool waitForBags(const QStringList& bags, const bool& active, const double& timeout);
+
+private:
+    ProcessSupervisor processes;
+    std::vector<int> ids;
+    QStringList fileNames;
+};
+
+}
+
+#endif // rqt_bag_player__recorder_H
@@ -0,0 +1,53 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__service_server_H
+#define rqt_bag_player__service_server_H
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rqt_bag_player {
+
+// Advertises the control services of a player. Each handler returns once
+// its operation has taken effect, or false with a message, and is called
+// on the server's own spinner thread so a slow one never blocks the
+// node's other callbacks.
+class ServiceServer
+{
+public:
+    struct Handlers
+    {
+        std::function<bool(const std::vector<std::string>& files, std::string& message)> load;
+        std::function<bool(const bool& play, std::string& message)> play;
+        std::function<bool(const double& time, std::string& message)> seek;
+        std::function<bool(const double& rate, std::string& message)> setRate;
+        std::function<bool(const size_t& count, std::string& message)> step;
+        std::function<bool(const bool& start, std::string& message)> record;
+        std::function<bool(const std::string& file, const std::vector<std::string>& topics, std::string& message)> exportBag;
+    };
+
+    ServiceServer();
+    ~ServiceServer();
+
+    // advertise the services under ns, e.g. ns/play, returns false if any
+    // of them is already advertised in this node
+    bool start(const std::string& ns, const Handlers& handlers);
+    void stop();
+
+private:
+    ros::CallbackQueue queue;
+    std::unique_ptr<ros::AsyncSpinner> spinner;
+    std::vector<ros::ServiceServer> servers;
+    Handlers handlers;
+};
+
+}
+
+#endif // rqt_bag_player__service_server_H
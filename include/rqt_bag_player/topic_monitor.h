@@ -0,0 +1,128 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#ifndef rqt_bag_player__topic_monitor_H
+#define rqt_bag_player__topic_monitor_H
+
+#include "rqt_bag_player/buffer_pool.h"
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <rosbag/bag.h>
+#include <topic_tools/shape_shifter.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rqt_bag_player {
+
+class TopicMonitor
+{
+public:
+    TopicMonitor();
+    ~TopicMonitor();
+
+    // number of callback queues, each served by its own spinner thread,
+    // the threads start with the first subscription
+    void setThreadCount(const int& count);
+
+    // subscribe to the given topics and drop the subscriptions of the others,
+    // transports maps a topic to "tcpnodelay" or "udp", tcp otherwise
+    void setTopics(const std::vector<std::string>& topics,
+        const std::map<std::string, std::string>& transports = std::map<std::string, std::string>());
+    void clear();
+
+    // wait until every subscription is connected to a publisher, false on timeout
+    bool waitForPublishers(const double& timeout);
+
+    // drop the subscriptions, the capture and the spinner threads
+    void shutdown();
+
+    // received bytes per second, 0 if nothing has been received yet
+    double bandwidth(const std::string& topic) const;
+
+    // LZ4 compression ratio of the latest sampled message, 0 if none was sampled
+    double compressionRatio(const std::string& topic) const;
+
+    // time source used to stamp the kept and captured messages, ros::Time::now() if empty
+    void setClock(const std::function<ros::Time()>& clock);
+
+    // keep the messages of the last seconds in a ring, 0 to disable
+    void setPreroll(const double& seconds);
+
+    // write the ring into a new bag and keep writing received messages into
+    // it until stopCapture(), so nothing is lost while rosbag record starts,
+    // without the pre-roll the ring is dropped instead
+    bool startCapture(const std::string& fileName, const bool& withPreroll = true);
+    void stopCapture();
+    bool isCapturing() const { return is_capturing; }
+
+    // drop the messages of the capture in fileName that were recorded into
+    // bags as well, those at or after the first message of their topic there,
+    // a bag recorded with --split is looked up as its first part
+    static bool trimCapture(const std::string& fileName, const std::vector<std::string>& bags);
+
+private:
+    struct Message
+    {
+        ros::Time stamp;
+        BufferPool::BufferPtr data;
+        size_t size;
+    };
+
+    struct Statistics
+    {
+        std::mutex mutex;
+        ros::Subscriber sub;
+        std::string transport;
+        ros::WallTime window_start;
+        uint64_t window_bytes;
+        double bandwidth;
+        ros::WallTime sample_time;
+        BufferPool::BufferPtr sample;
+        size_t sample_size;
+        std::string datatype;
+        std::string md5sum;
+        std::string definition;
+        std::deque<Message> ring;
+    };
+    typedef std::shared_ptr<Statistics> StatisticsPtr;
+
+    struct Group
+    {
+        ros::CallbackQueue queue;
+        std::unique_ptr<ros::AsyncSpinner> spinner;
+    };
+
+    void startSpinners();
+    void subscribe(const std::string& topic, const StatisticsPtr& stat);
+    void callback(const std::string& topic, Statistics& stat, const topic_tools::ShapeShifter::ConstPtr& msg);
+    ros::Time now() const;
+    StatisticsPtr find(const std::string& topic) const;
+
+    ros::NodeHandle n;
+    mutable BufferPool pool;
+    std::vector<std::unique_ptr<Group>> groups;
+    mutable std::mutex mutex;
+    std::map<std::string, StatisticsPtr> statistics;
+    size_t next_group;
+    int thread_count;
+
+    mutable std::mutex clock_mutex;
+    std::function<ros::Time()> clock;
+    std::atomic<double> preroll;
+    std::atomic<bool> is_capturing;
+    std::mutex capture_mutex;
+    std::unique_ptr<rosbag::Bag> capture;
+};
+
+}
+
+#endif // rqt_bag_player__topic_monitor_H
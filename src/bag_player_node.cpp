@@ -0,0 +1,176 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/bag_player_engine.h"
+#include "rqt_bag_player/service_server.h"
+
+#include <ros/ros.h>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+
+#include <string>
+#include <vector>
+
+using namespace rqt_bag_player;
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "bag_player");
+
+    // only the process handling of QtCore is used, no event loop is run
+    QCoreApplication app(argc, argv);
+
+    ros::NodeHandle pn("~");
+    std::vector<std::string> bags;
+    std::vector<std::string> topics;
+    std::vector<std::string> record_topics;
+    std::string bag;
+    std::string record_dir = QDir::currentPath().toStdString();
+    double rate = 1.0;
+    double start = 0.0;
+    double clock_hz = 0.0;
+    double clock_offset = 0.0;
+    bool is_loop = false;
+    bool is_clock = true;
+    bool is_clock_wall_time = false;
+    bool is_autoplay = true;
+    bool is_record = false;
+    int split_size = 0;
+    pn.getParam("bags", bags);
+    if(pn.getParam("bag", bag)) {
+        bags.push_back(bag);
+    }
+    pn.getParam("topics", topics);
+    pn.getParam("rate", rate);
+    pn.getParam("start", start);
+    pn.getParam("loop", is_loop);
+    pn.getParam("clock", is_clock);
+    pn.getParam("clock_hz", clock_hz);
+    pn.getParam("clock_offset", clock_offset);
+    pn.getParam("clock_wall_time", is_clock_wall_time);
+    pn.getParam("autoplay", is_autoplay);
+    pn.getParam("record", is_record);
+    pn.getParam("record_topics", record_topics);
+    pn.getParam("record_dir", record_dir);
+    pn.getParam("split_size", split_size);
+
+    BagPlayerEngine engine;
+    engine.setRate(rate);
+    engine.setLoop(is_loop);
+    engine.setPublishClock(is_clock);
+    engine.setClockFrequency(clock_hz);
+    engine.setClockOffset(clock_offset);
+    engine.setClockWallTime(is_clock_wall_time);
+    engine.setStatisticsCallback([](const BagPlayerEngine::Statistics& statistics){
+        ROS_DEBUG("Played %lu messages, %.1f msg/s, %.1f kB/s",
+            (unsigned long)statistics.messages, statistics.message_rate, statistics.bandwidth / 1024.0);
+    });
+
+    auto load = [&](const std::vector<std::string>& files, std::string& message){
+        if(!engine.load(files)) {
+            message = "Failed to open the bags";
+            return false;
+        }
+        if(!topics.empty()) {
+            engine.setTopics(topics);
+        }
+        return true;
+    };
+    auto startRecord = [&](std::string& message){
+        QString fileName = QDir(QString::fromStdString(record_dir)).filePath(QString("record_%1.bag")
+            .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss")));
+        if(!engine.startRecord(fileName.toStdString(), record_topics, std::vector<std::string>(), split_size)) {
+            message = record_topics.empty() ? "No record topics" : "Recorder did not start";
+            return false;
+        }
+        return true;
+    };
+
+    // the engine serializes the calls, the handlers only translate them
+    ServiceServer::Handlers handlers;
+    handlers.load = load;
+    handlers.play = [&](const bool& on, std::string& message){
+        if(!on) {
+            engine.pause();
+            return true;
+        }
+        if(!engine.play()) {
+            message = "No bag is open";
+            return false;
+        }
+        return true;
+    };
+    handlers.seek = [&](const double& time, std::string& message){
+        if(!engine.seek(time)) {
+            message = "Time is out of the bag";
+            return false;
+        }
+        return true;
+    };
+    handlers.setRate = [&](const double& value, std::string& message){
+        if(value <= 0.0) {
+            message = "Rate must be positive";
+            return false;
+        }
+        engine.setRate(value);
+        return true;
+    };
+    handlers.step = [&](const size_t& count, std::string& message){
+        if(!engine.step(count)) {
+            message = "No bag is open";
+            return false;
+        }
+        return true;
+    };
+    handlers.record = [&](const bool& on, std::string& message){
+        if(on) {
+            return engine.isRecording() || startRecord(message);
+        }
+        if(!engine.stopRecord()) {
+            message = "Recorder did not close its bags";
+            return false;
+        }
+        return true;
+    };
+    handlers.exportBag = [&](const std::string& file, const std::vector<std::string>& names, std::string& message){
+        std::vector<std::string> exportTopics = names;
+        if(exportTopics.empty()) {
+            exportTopics = topics;
+        }
+        if(exportTopics.empty()) {
+            for(auto& topic : engine.topics()) {
+                exportTopics.push_back(topic.first);
+            }
+        }
+        if(!engine.exportBag(file, exportTopics)) {
+            message = "Nothing to export or rosbag filter failed";
+            return false;
+        }
+        return true;
+    };
+
+    ServiceServer services;
+    services.start("~", handlers);
+
+    std::string message;
+    if(!bags.empty() && load(bags, message) && is_autoplay) {
+        engine.seek(start);
+        engine.play();
+    }
+    if(is_record && !startRecord(message)) {
+        ROS_WARN("%s", message.c_str());
+    }
+
+    // the player and the services have their own threads
+    ros::waitForShutdown();
+
+    services.stop();
+    engine.close();
+    if(engine.isRecording()) {
+        engine.stopRecord();
+    }
+    return 0;
+}
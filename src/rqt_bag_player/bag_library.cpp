@@ -0,0 +1,418 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/bag_library.h"
+
+#include <rosbag/bag.h>
+#include <rosbag/query.h>
+#include <rosbag/view.h>
+
+#include <QBoxLayout>
+#include <QDir>
+#include <QDoubleSpinBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QGridLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMutexLocker>
+#include <QPushButton>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QTreeWidgetItem>
+
+#include <set>
+
+namespace rqt_bag_player {
+
+namespace {
+
+// paths under a directory are matched by their prefix, LIKE would take
+// '_' and '%' in the directory name as wildcards and ignore case
+const char* const UnderDirectory = "substr(path, 1, length(?)) = ?";
+
+bool openDatabase(const QString& connectionName, const QString& databaseName)
+{
+    QDir().mkpath(QFileInfo(databaseName).absolutePath());
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(databaseName);
+    if(!db.open()) {
+        return false;
+    }
+
+    // WAL lets the GUI query while the indexer writes
+    QSqlQuery query(db);
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("CREATE TABLE IF NOT EXISTS bags (path TEXT PRIMARY KEY, size INTEGER, mtime INTEGER, "
+        "begin REAL, end REAL, duration REAL, messages INTEGER)");
+    query.exec("CREATE TABLE IF NOT EXISTS topics (path TEXT, topic TEXT, datatype TEXT, count INTEGER)");
+    query.exec("CREATE INDEX IF NOT EXISTS topics_topic ON topics (topic)");
+    query.exec("CREATE INDEX IF NOT EXISTS topics_path ON topics (path)");
+    return true;
+}
+
+}
+
+BagIndexer::BagIndexer(const QString& databaseName, QObject* parent)
+    : QThread(parent)
+    , databaseName(databaseName)
+    , is_stopping(false)
+{
+    connectionName = QString("rqt_bag_player_indexer_%1").arg((quintptr)this);
+}
+
+BagIndexer::~BagIndexer()
+{
+    stop();
+}
+
+void BagIndexer::enqueue(const QString& path)
+{
+    QMutexLocker locker(&mutex);
+    if(!queue.contains(path)) {
+        queue << path;
+    }
+    condition.wakeOne();
+}
+
+void BagIndexer::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        is_stopping = true;
+        condition.wakeOne();
+    }
+    wait();
+}
+
+void BagIndexer::run()
+{
+    if(!openDatabase(connectionName, databaseName)) {
+        return;
+    }
+
+    while(true) {
+        QString path;
+        {
+            QMutexLocker locker(&mutex);
+            while(queue.isEmpty() && !is_stopping) {
+                condition.wait(&mutex);
+            }
+            if(is_stopping) {
+                break;
+            }
+            path = queue.takeFirst();
+        }
+
+        QFileInfo info(path);
+        if(!info.isFile()) {
+            scan(path);
+        } else if(!isIndexed(info)) {
+            indexFile(info.absoluteFilePath());
+        }
+    }
+
+    QSqlDatabase::database(connectionName).close();
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+void BagIndexer::scan(const QString& dir)
+{
+    QSqlDatabase db = QSqlDatabase::database(connectionName);
+    std::set<QString> files;
+
+    // only this directory, subdirectories are reported and queued separately
+    QDir d(dir);
+    for(auto& info : d.entryInfoList(QStringList() << "*.bag", QDir::Files)) {
+        files.insert(info.absoluteFilePath());
+        if(isIndexed(info)) {
+            continue;
+        }
+        indexFile(info.absoluteFilePath());
+
+        QMutexLocker locker(&mutex);
+        if(is_stopping) {
+            return;
+        }
+    }
+
+    for(auto& info : d.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        emit directoryFound(info.absoluteFilePath());
+    }
+
+    // drop the bags that were removed from this directory
+    QSqlQuery query(db);
+    query.prepare(QString("SELECT path FROM bags WHERE %1").arg(UnderDirectory));
+    QString prefix = QDir(dir).absolutePath() + "/";
+    query.addBindValue(prefix);
+    query.addBindValue(prefix);
+    QStringList removed;
+    if(query.exec()) {
+        while(query.next()) {
+            QString path = query.value(0).toString();
+            if(QFileInfo(path).absolutePath() == QDir(dir).absolutePath() && files.count(path) == 0) {
+                removed << path;
+            }
+        }
+    }
+    for(auto& path : removed) {
+        QSqlQuery remove(db);
+        remove.prepare("DELETE FROM bags WHERE path = ?");
+        remove.addBindValue(path);
+        remove.exec();
+        remove.prepare("DELETE FROM topics WHERE path = ?");
+        remove.addBindValue(path);
+        remove.exec();
+    }
+}
+
+bool BagIndexer::isIndexed(const QFileInfo& info)
+{
+    QSqlQuery query(QSqlDatabase::database(connectionName));
+    query.prepare("SELECT size, mtime FROM bags WHERE path = ?");
+    query.addBindValue(info.absoluteFilePath());
+    return query.exec() && query.next()
+        && query.value(0).toLongLong() == info.size()
+        && query.value(1).toLongLong() == info.lastModified().toMSecsSinceEpoch();
+}
+
+void BagIndexer::indexFile(const QString& fileName)
+{
+    QFileInfo info(fileName);
+    QSqlDatabase db = QSqlDatabase::database(connectionName);
+
+    try {
+        rosbag::Bag bag(fileName.toStdString());
+        rosbag::View view(bag);
+
+        db.transaction();
+        QSqlQuery query(db);
+        query.prepare("DELETE FROM topics WHERE path = ?");
+        query.addBindValue(fileName);
+        query.exec();
+
+        // counts come from the index, no message is read
+        std::set<std::string> topics;
+        for(auto& connection : view.getConnections()) {
+            if(!topics.insert(connection->topic).second) {
+                continue;
+            }
+            rosbag::View topicView(bag, rosbag::TopicQuery(connection->topic));
+            query.prepare("INSERT INTO topics (path, topic, datatype, count) VALUES (?, ?, ?, ?)");
+            query.addBindValue(fileName);
+            query.addBindValue(QString::fromStdString(connection->topic));
+            query.addBindValue(QString::fromStdString(connection->datatype));
+            query.addBindValue((qlonglong)topicView.size());
+            query.exec();
+        }
+
+        query.prepare("INSERT OR REPLACE INTO bags (path, size, mtime, begin, end, duration, messages) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?)");
+        query.addBindValue(fileName);
+        query.addBindValue(info.size());
+        query.addBindValue(info.lastModified().toMSecsSinceEpoch());
+        query.addBindValue(view.getBeginTime().toSec());
+        query.addBindValue(view.getEndTime().toSec());
+        query.addBindValue((view.getEndTime() - view.getBeginTime()).toSec());
+        query.addBindValue((qlonglong)view.size());
+        query.exec();
+        db.commit();
+    } catch(rosbag::BagException&) {
+        // bags still being recorded or broken ones are skipped
+        return;
+    }
+
+    emit indexed(fileName);
+}
+
+BagLibrary::BagLibrary(QWidget* parent)
+    : QWidget(parent)
+{
+    connectionName = QString("rqt_bag_player_library_%1").arg((quintptr)this);
+    openDatabase(connectionName, defaultDatabaseName());
+
+    indexer = new BagIndexer(defaultDatabaseName(), this);
+    watcher = new QFileSystemWatcher(this);
+
+    auto queryTimer = new QTimer(this);
+    queryTimer->setSingleShot(true);
+    queryTimer->setInterval(500);
+    connect(queryTimer, &QTimer::timeout, [&](){ query(); });
+
+    connect(indexer, &BagIndexer::directoryFound,
+        this, [&](const QString& dir){ on_indexer_directoryFound(dir); }, Qt::QueuedConnection);
+    connect(indexer, &BagIndexer::indexed,
+        this, [=](const QString&){ queryTimer->start(); }, Qt::QueuedConnection);
+
+    // inotify reports changes per directory, only that directory is rescanned
+    connect(watcher, &QFileSystemWatcher::directoryChanged,
+        [&](const QString& dir){ indexer->enqueue(dir); });
+
+    auto browseButton = new QPushButton("Browse...");
+    connect(browseButton, &QPushButton::clicked, [&](){ browse(); });
+
+    topicLine = new QLineEdit;
+    topicLine->setPlaceholderText("/velodyne_points");
+    connect(topicLine, &QLineEdit::textChanged, [=](){ queryTimer->start(); });
+
+    durationSpin = new QDoubleSpinBox;
+    durationSpin->setRange(0.0, 100000.0);
+    durationSpin->setSuffix(" min");
+    connect(durationSpin, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+        [=](double){ queryTimer->start(); });
+
+    resultTree = new QTreeWidget;
+    resultTree->setHeaderLabels(QStringList() << "Bag" << "Duration" << "Size");
+    resultTree->setRootIsDecorated(false);
+    resultTree->setSortingEnabled(true);
+    connect(resultTree, &QTreeWidget::itemDoubleClicked,
+        [&](QTreeWidgetItem* item, int){ emit bagActivated(item->data(0, Qt::UserRole).toString()); });
+
+    statusLabel = new QLabel;
+
+    auto gridLayout = new QGridLayout;
+    gridLayout->addWidget(new QLabel("Topic"), 0, 0);
+    gridLayout->addWidget(topicLine, 0, 1);
+    gridLayout->addWidget(browseButton, 0, 2);
+    gridLayout->addWidget(new QLabel("Longer than"), 1, 0);
+    gridLayout->addWidget(durationSpin, 1, 1);
+
+    auto mainLayout = new QVBoxLayout;
+    mainLayout->addLayout(gridLayout);
+    mainLayout->addWidget(resultTree);
+    mainLayout->addWidget(statusLabel);
+    setLayout(mainLayout);
+
+    indexer->start(QThread::LowPriority);
+}
+
+BagLibrary::~BagLibrary()
+{
+    indexer->stop();
+    QSqlDatabase::database(connectionName).close();
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+void BagLibrary::setRootDirectory(const QString& dir)
+{
+    if(!watcher->directories().isEmpty()) {
+        watcher->removePaths(watcher->directories());
+    }
+
+    rootDir = dir;
+    if(!rootDir.isEmpty()) {
+        on_indexer_directoryFound(rootDir);
+    }
+    query();
+}
+
+QString BagLibrary::defaultDatabaseName()
+{
+    return QDir::home().filePath(".ros/rqt_bag_player/library.db");
+}
+
+bool BagLibrary::cachedBag(const QString& fileName, CachedBag& bag, const QString& databaseName)
+{
+    QFileInfo info(fileName);
+    if(!info.isFile() || !QFileInfo(databaseName).isFile()) {
+        return false;
+    }
+
+    bool result = false;
+    QString connectionName = QString("rqt_bag_player_cache_%1").arg((quintptr)&bag);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databaseName);
+        if(db.open()) {
+            QSqlQuery query(db);
+            query.prepare("SELECT size, mtime, begin, end FROM bags WHERE path = ?");
+            query.addBindValue(info.absoluteFilePath());
+            if(query.exec() && query.next()
+                && query.value(0).toLongLong() == info.size()
+                && query.value(1).toLongLong() == info.lastModified().toMSecsSinceEpoch()) {
+                bag.begin_time = query.value(2).toDouble();
+                bag.end_time = query.value(3).toDouble();
+                bag.topics.clear();
+
+                QSqlQuery topicQuery(db);
+                topicQuery.prepare("SELECT topic, datatype FROM topics WHERE path = ?");
+                topicQuery.addBindValue(info.absoluteFilePath());
+                if(topicQuery.exec()) {
+                    while(topicQuery.next()) {
+                        bag.topics << qMakePair(topicQuery.value(0).toString(), topicQuery.value(1).toString());
+                    }
+                }
+                result = true;
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return result;
+}
+
+void BagLibrary::browse()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, "Library Directory",
+        rootDir.isEmpty() ? QDir::homePath() : rootDir);
+    if(!dir.isEmpty()) {
+        setRootDirectory(dir);
+    }
+}
+
+void BagLibrary::query()
+{
+    resultTree->clear();
+    if(rootDir.isEmpty()) {
+        return;
+    }
+
+    QString topic = topicLine->text().trimmed();
+    QSqlQuery query(QSqlDatabase::database(connectionName));
+    QString sql = QString("SELECT path, duration, size FROM bags WHERE %1 AND duration >= ?").arg(UnderDirectory);
+    if(!topic.isEmpty()) {
+        sql += " AND path IN (SELECT path FROM topics WHERE topic = ?)";
+    }
+    query.prepare(sql);
+    QString prefix = QDir(rootDir).absolutePath() + "/";
+    query.addBindValue(prefix);
+    query.addBindValue(prefix);
+    query.addBindValue(durationSpin->value() * 60.0);
+    if(!topic.isEmpty()) {
+        query.addBindValue(topic);
+    }
+
+    if(!query.exec()) {
+        statusLabel->setText(query.lastError().text());
+        return;
+    }
+
+    int count = 0;
+    while(query.next()) {
+        QString path = query.value(0).toString();
+        QTreeWidgetItem* item = new QTreeWidgetItem(resultTree);
+        item->setText(0, QDir(rootDir).relativeFilePath(path));
+        item->setData(0, Qt::UserRole, path);
+        item->setText(1, QString("%1 s").arg(query.value(1).toDouble(), 0, 'f', 1));
+        item->setText(2, QString("%1 MB").arg(query.value(2).toLongLong() / (1024 * 1024)));
+        ++count;
+    }
+    statusLabel->setText(QString("%1 bags").arg(count));
+}
+
+void BagLibrary::on_indexer_directoryFound(const QString& dir)
+{
+    // directories already watched are rescanned through directoryChanged
+    if(!watcher->directories().contains(dir)) {
+        watcher->addPath(dir);
+        indexer->enqueue(dir);
+    }
+}
+
+}
@@ -0,0 +1,792 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/bag_player.h"
+#include "rqt_bag_player/bag_registry.h"
+
+#include <rosbag/query.h>
+#include <rosbag/view.h>
+#include <rosgraph_msgs/Clock.h>
+#include <topic_tools/shape_shifter.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <set>
+
+namespace rqt_bag_player {
+
+namespace {
+
+// give subscribers time to connect to newly advertised topics
+const double AdvertiseDelay = 0.2;
+
+// bin width of the arrival histograms used to estimate offsets
+const double HistogramResolution = 0.01;
+
+// bytes each reader may read ahead of playback, at least one message
+const size_t MaxReadAhead = 4 * 1024 * 1024;
+
+ros::Time shift(const ros::Time& time, const ros::Duration& offset)
+{
+    int64_t nsec = (int64_t)time.toNSec() + offset.toNSec();
+    ros::Time shifted;
+    shifted.fromNSec(nsec > 0 ? nsec : 0);
+    return shifted;
+}
+
+// the bag's own names of the topics to play, a bag remapped under a
+// prefix only plays the topics selected under that prefix
+std::vector<std::string> bagTopics(const std::vector<std::string>& topics, const std::string& prefix)
+{
+    std::vector<std::string> names;
+    for(auto& topic : topics) {
+        if(prefix.empty()) {
+            names.push_back(topic);
+        } else if(topic.compare(0, prefix.size() + 1, prefix + "/") == 0) {
+            names.push_back(topic.substr(prefix.size()));
+        }
+    }
+    return names;
+}
+
+}
+
+// where the clock thread finds the playback, read while run() moves on
+struct BagPlayer::ClockSchedule
+{
+    // bag time due at the wall time wall_begin, zero while waiting for subscribers
+    std::atomic<int64_t> bag_begin;
+    std::atomic<int64_t> wall_begin;
+
+    // bag time played in previous loops and their number
+    std::atomic<int64_t> elapsed;
+    std::atomic<int> loop;
+    std::atomic<bool> is_done;
+
+    double rate;
+    ros::Time end_time;
+    ros::Duration offset;
+
+    // wall time the start of playback is mapped to, zero to publish bag time
+    ros::Time wall_anchor;
+
+    ros::Time toClock(const ros::Time& time) const
+    {
+        ros::Time clock = time;
+        if(!wall_anchor.isZero()) {
+            ros::Duration played;
+            played.fromNSec(elapsed + (int64_t)time.toNSec() - bag_begin);
+            clock = wall_anchor + played;
+        }
+        return shift(clock, offset);
+    }
+};
+
+namespace {
+
+struct Message
+{
+    ros::Time time;
+    std::string topic;
+    topic_tools::ShapeShifter::ConstPtr msg;
+    size_t size;
+};
+
+// reads the messages of one view ahead of playback on its own thread
+class Reader
+{
+public:
+    Reader(std::unique_ptr<rosbag::View> view, const ros::Duration& offset, const std::string& prefix)
+        : view(std::move(view))
+        , offset(offset)
+        , prefix(prefix)
+        , bytes(0)
+        , is_done(false)
+        , is_aborted(false)
+    {
+        thread = std::thread([this](){ run(); });
+    }
+
+    ~Reader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            is_aborted = true;
+        }
+        condition.notify_all();
+        thread.join();
+    }
+
+    // wait for the next message, false at the end of the view
+    bool next(Message& message)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&](){ return !queue.empty() || is_done || is_aborted; });
+        if(queue.empty()) {
+            return false;
+        }
+
+        message = std::move(queue.front());
+        queue.pop_front();
+        bytes -= message.size;
+        condition.notify_all();
+        return true;
+    }
+
+private:
+    void run()
+    {
+        try {
+            for(const rosbag::MessageInstance& m : *view) {
+                Message message;
+                message.time = shift(m.getTime(), offset);
+                message.topic = prefix + m.getTopic();
+                message.msg = m.instantiate<topic_tools::ShapeShifter>();
+                message.size = m.size();
+
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&](){ return queue.empty() || bytes < MaxReadAhead || is_aborted; });
+                if(is_aborted) {
+                    return;
+                }
+                bytes += message.size;
+                queue.push_back(std::move(message));
+                condition.notify_all();
+            }
+        } catch(rosbag::BagException& ex) {
+            ROS_ERROR("Failed to read bag: %s", ex.what());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        is_done = true;
+        condition.notify_all();
+    }
+
+    std::unique_ptr<rosbag::View> view;
+    ros::Duration offset;
+    std::string prefix;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Message> queue;
+    size_t bytes;
+    bool is_done;
+    bool is_aborted;
+    std::thread thread;
+};
+
+}
+
+BagPlayer::BagPlayer()
+    : rate(1.0)
+    , is_loop(false)
+    , is_clock(true)
+    , clock_frequency(0.0)
+    , clock_offset(0.0)
+    , is_clock_wall_time(false)
+    , is_playing(false)
+    , is_stopping(false)
+    , current_time(0)
+    , next_time(0)
+    , next_skip(0)
+{
+
+}
+
+BagPlayer::~BagPlayer()
+{
+    close();
+}
+
+bool BagPlayer::open(const std::vector<std::string>& fileNames)
+{
+    // bags already opened in this process, e.g. by another window, are shared
+    std::vector<std::shared_ptr<rosbag::Bag>> bags;
+    try {
+        for(auto& fileName : fileNames) {
+            bags.push_back(BagRegistry::instance().open(fileName));
+        }
+    } catch(rosbag::BagException& ex) {
+        ROS_ERROR("Failed to open bag: %s", ex.what());
+        close();
+        return false;
+    }
+    return open(bags);
+}
+
+bool BagPlayer::open(const std::vector<std::shared_ptr<rosbag::Bag>>& bags)
+{
+    close();
+    this->bags = bags;
+    read_bags.assign(bags.size(), nullptr);
+
+    // all files stay open and are merged while playing, so playback and
+    // seeks cross the boundaries of a split recording without reopening,
+    // the segments tell which files are read at a given time
+    for(auto& bag : bags) {
+        std::shared_ptr<const BagRegistry::Index> index = BagRegistry::instance().index(bag);
+        Segment segment;
+        segment.begin_time = index->begin_time;
+        segment.end_time = index->end_time;
+        segment.fileName = bag->getFileName();
+        segments.push_back(segment);
+    }
+    offsets.assign(bags.size(), ros::Duration(0.0));
+    prefixes.assign(bags.size(), std::string());
+    updateRange();
+    current_time = begin_time.toNSec();
+    next_time = begin_time.toNSec();
+    next_skip = 0;
+    return !bags.empty();
+}
+
+void BagPlayer::close()
+{
+    stop();
+    publishers.clear();
+    bags.clear();
+    read_bags.clear();
+    segments.clear();
+    offsets.clear();
+    prefixes.clear();
+    begin_time = ros::Time();
+    end_time = ros::Time();
+}
+
+std::string BagPlayer::fileName(const ros::Time& time) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string fileName;
+    ros::Time latest;
+    for(size_t i = 0; i < segments.size(); ++i) {
+        ros::Time begin = shift(segments[i].begin_time, offsets[i]);
+        if(begin <= time && (fileName.empty() || begin >= latest)) {
+            fileName = segments[i].fileName;
+            latest = begin;
+        }
+    }
+    return fileName;
+}
+
+void BagPlayer::setOffset(const size_t& index, const ros::Duration& offset)
+{
+    if(index >= offsets.size()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        offsets[index] = offset;
+    }
+    updateRange();
+}
+
+ros::Duration BagPlayer::offset(const size_t& index) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return index < offsets.size() ? offsets[index] : ros::Duration(0.0);
+}
+
+ros::Duration BagPlayer::estimateOffset(const size_t& index, const size_t& reference,
+    const std::string& topic, const double& maxOffset) const
+{
+    if(index >= bags.size() || reference >= bags.size() || index == reference) {
+        return offset(index);
+    }
+
+    // message arrival histograms on the bags' own clocks, only the index is read
+    ros::Time origin = std::min(segments[index].begin_time, segments[reference].begin_time);
+    auto histogram = [&](const size_t& i){
+        std::map<int64_t, double> bins;
+        rosbag::View view(*bags[i], rosbag::TopicQuery(topic));
+        for(const rosbag::MessageInstance& m : view) {
+            bins[(int64_t)((m.getTime() - origin).toSec() / HistogramResolution)] += 1.0;
+        }
+        return bins;
+    };
+    std::map<int64_t, double> a = histogram(reference);
+    std::map<int64_t, double> b = histogram(index);
+    if(a.empty() || b.empty()) {
+        return offset(index);
+    }
+
+    // the lag maximizing the cross-correlation is the clock difference,
+    // a periodic topic matches several lags, irregular ones align best
+    int64_t maxLag = (int64_t)(maxOffset / HistogramResolution);
+    std::vector<double> correlation(2 * maxLag + 1, 0.0);
+    for(auto& bin : a) {
+        auto it = b.lower_bound(bin.first - maxLag);
+        for(; it != b.end() && it->first <= bin.first + maxLag; ++it) {
+            correlation[it->first - bin.first + maxLag] += bin.second * it->second;
+        }
+    }
+
+    int64_t lag = std::max_element(correlation.begin(), correlation.end()) - correlation.begin() - maxLag;
+    return offset(reference) - ros::Duration(lag * HistogramResolution);
+}
+
+std::vector<std::pair<std::string, std::string>> BagPlayer::topics() const
+{
+    std::vector<std::string> prefixes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        prefixes = this->prefixes;
+    }
+
+    std::set<std::string> names;
+    std::vector<std::pair<std::string, std::string>> topics;
+    for(size_t i = 0; i < bags.size(); ++i) {
+        for(auto& topic : BagRegistry::instance().index(bags[i])->topics) {
+            std::string name = prefixes[i] + topic.first;
+            if(names.insert(name).second) {
+                topics.push_back(std::make_pair(name, topic.second));
+            }
+        }
+    }
+    return topics;
+}
+
+void BagPlayer::setPrefix(const size_t& index, const std::string& prefix)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(index < prefixes.size()) {
+        prefixes[index] = prefix.size() > 1 && prefix.back() == '/' ? prefix.substr(0, prefix.size() - 1) : prefix;
+        if(prefixes[index] == "/") {
+            prefixes[index].clear();
+        }
+    }
+}
+
+void BagPlayer::setRate(const double& rate)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->rate = rate > 0.0 ? rate : 1.0;
+}
+
+void BagPlayer::setLoop(const bool& on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    is_loop = on;
+}
+
+void BagPlayer::setPublishClock(const bool& on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    is_clock = on;
+}
+
+void BagPlayer::setClockFrequency(const double& frequency)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    clock_frequency = frequency > 0.0 ? frequency : 0.0;
+}
+
+void BagPlayer::setClockOffset(const ros::Duration& offset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    clock_offset = offset;
+}
+
+void BagPlayer::setClockWallTime(const bool& on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    is_clock_wall_time = on;
+}
+
+void BagPlayer::setTopics(const std::vector<std::string>& topics)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    play_topics = topics;
+}
+
+void BagPlayer::setPublishCallback(const std::function<void(const ros::Time&, const uint32_t&)>& callback)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    publish_callback = callback;
+}
+
+void BagPlayer::play(const double& start)
+{
+    stop();
+    if(bags.empty()) {
+        return;
+    }
+
+    ros::Time start_time = begin_time + ros::Duration(start);
+    current_time = start_time.toNSec();
+    next_time = start_time.toNSec();
+    next_skip = 0;
+    is_stopping = false;
+    is_playing = true;
+    thread = std::thread([this, start_time](){ run(start_time, 0); });
+}
+
+void BagPlayer::resume()
+{
+    stop();
+    if(bags.empty()) {
+        return;
+    }
+
+    ros::Time start_time;
+    start_time.fromNSec(next_time);
+    is_stopping = false;
+    is_playing = true;
+    thread = std::thread([this, start_time](){ run(start_time, 0); });
+}
+
+void BagPlayer::seek(const double& start)
+{
+    bool was_playing = is_playing;
+    stop();
+
+    ros::Time start_time = begin_time + ros::Duration(start);
+    current_time = start_time.toNSec();
+    next_time = start_time.toNSec();
+    next_skip = 0;
+    if(was_playing) {
+        resume();
+    }
+}
+
+ros::Time BagPlayer::step(const size_t& count)
+{
+    stop();
+    if(!bags.empty() && count > 0) {
+        ros::Time start_time;
+        start_time.fromNSec(next_time);
+        is_stopping = false;
+        run(start_time, count);
+    }
+    return currentTime();
+}
+
+void BagPlayer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_stopping = true;
+    }
+    condition.notify_all();
+
+    if(thread.joinable()) {
+        thread.join();
+    }
+    is_playing = false;
+}
+
+ros::Time BagPlayer::currentTime() const
+{
+    ros::Time time;
+    time.fromNSec(current_time);
+    return time;
+}
+
+void BagPlayer::run(const ros::Time& start, const size_t& count)
+{
+    std::vector<std::string> topics;
+    std::vector<ros::Duration> offsets;
+    std::vector<std::string> prefixes;
+    ros::Time begin_time;
+    ros::Time end_time;
+    double rate;
+    bool is_loop;
+    bool is_clock;
+    double clock_frequency;
+    ClockSchedule schedule;
+    std::function<void(const ros::Time&, const uint32_t&)> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        topics = play_topics;
+        callback = publish_callback;
+        offsets = this->offsets;
+        prefixes = this->prefixes;
+        begin_time = this->begin_time;
+        end_time = this->end_time;
+        rate = this->rate;
+        is_loop = this->is_loop;
+        is_clock = this->is_clock;
+        clock_frequency = this->clock_frequency;
+        schedule.offset = clock_offset;
+        schedule.wall_anchor = is_clock_wall_time ? ros::Time(ros::WallTime::now().toSec()) : ros::Time();
+    }
+    schedule.bag_begin = start.toNSec();
+    schedule.wall_begin = 0;
+    schedule.elapsed = 0;
+    schedule.loop = 0;
+    schedule.is_done = false;
+    schedule.rate = rate;
+    schedule.end_time = end_time;
+
+    if(is_clock && !clock_pub) {
+        clock_pub = n.advertise<rosgraph_msgs::Clock>("clock", 1);
+    }
+
+    // at a fixed frequency the clock is a task of its own, so dense topics
+    // neither delay nor multiply its ticks, stepped messages carry it along
+    std::thread clock_thread;
+    if(is_clock && clock_frequency > 0.0 && count == 0) {
+        clock_thread = std::thread([&](){ runClock(schedule, clock_frequency); });
+    }
+
+    // the files in the order they start on the aligned timeline
+    std::vector<size_t> order(bags.size());
+    for(size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const size_t& a, const size_t& b){
+        return shift(segments[a].begin_time, offsets[a]) < shift(segments[b].begin_time, offsets[b]);
+    });
+
+    ros::Time start_time = start;
+    ros::Time last_clock;
+    size_t published = 0;
+
+    // messages at the start that were published before a pause
+    size_t skip = (int64_t)start.toNSec() == next_time ? next_skip : 0;
+    bool is_first = true;
+    while(!is_stopping) {
+        // every topic is advertised up front from the index, so subscribers
+        // are connected before the files publishing them are read
+        bool is_advertised = false;
+        for(size_t i = 0; i < bags.size(); ++i) {
+            rosbag::View view(*bags[i], rosbag::TopicQuery(bagTopics(topics, prefixes[i])));
+            for(auto& info : view.getConnections()) {
+                std::string topic = prefixes[i] + info->topic;
+                if(publishers.count(topic) == 0) {
+                    ros::AdvertiseOptions options(topic, 100, info->md5sum, info->datatype, info->msg_def);
+                    auto latching = info->header->find("latching");
+                    options.latch = latching != info->header->end() && latching->second == "1";
+                    publishers[topic] = n.advertise(options);
+                    is_advertised = true;
+                }
+            }
+        }
+
+        if((is_first || is_advertised) && !sleepUntil(ros::WallTime::now() + ros::WallDuration(AdvertiseDelay))) {
+            break;
+        }
+        is_first = false;
+
+        // the readers are merged on a heap keyed by the aligned time, the
+        // offsets are applied to the keys and the files stay untouched
+        typedef std::pair<ros::Time, size_t> Key;
+        std::priority_queue<Key, std::vector<Key>, std::greater<Key>> heap;
+        std::vector<std::unique_ptr<Reader>> readers(bags.size());
+        std::vector<Message> heads(bags.size());
+
+        // a file gets a view, queried on its own clock and read ahead on its
+        // own thread, only once playback reaches it, and is let go at its
+        // end, so the parts of a long split recording are read one by one
+        size_t next_bag = 0;
+        auto openReaders = [&](){
+            while(next_bag < order.size()) {
+                size_t i = order[next_bag];
+                if(!heap.empty() && shift(segments[i].begin_time, offsets[i]) > heap.top().first) {
+                    break;
+                }
+                ++next_bag;
+                if(shift(segments[i].end_time, offsets[i]) < start_time) {
+                    continue;
+                }
+
+                if(!read_bags[i]) {
+                    try {
+                        read_bags[i] = BagRegistry::instance().openReader(bags[i]);
+                    } catch(rosbag::BagException& ex) {
+                        ROS_ERROR("Failed to open %s: %s", segments[i].fileName.c_str(), ex.what());
+                        continue;
+                    }
+                }
+
+                std::unique_ptr<rosbag::View> view(new rosbag::View(*read_bags[i], rosbag::TopicQuery(bagTopics(topics, prefixes[i])),
+                    shift(start_time, -offsets[i]), shift(end_time, -offsets[i])));
+                readers[i].reset(new Reader(std::move(view), offsets[i], prefixes[i]));
+                if(readers[i]->next(heads[i])) {
+                    heap.push(Key(heads[i].time, i));
+                } else {
+                    readers[i].reset();
+                }
+            }
+        };
+        openReaders();
+
+        // messages are published at their aligned time relative to the start, scaled by the rate
+        ros::WallTime wall_start = ros::WallTime::now();
+        schedule.wall_begin = wall_start.toNSec();
+        bool is_empty = heap.empty();
+        while(!heap.empty()) {
+            ros::Time time = heap.top().first;
+            size_t i = heap.top().second;
+            heap.pop();
+
+            if(skip > 0 && time == start_time) {
+                --skip;
+                if(readers[i]->next(heads[i])) {
+                    heap.push(Key(heads[i].time, i));
+                } else {
+                    readers[i].reset();
+                }
+                openReaders();
+                continue;
+            }
+            skip = 0;
+
+            // stepped messages are published right away
+            ros::WallTime target = count > 0 ? wall_start
+                : wall_start + ros::WallDuration((time - start_time).toSec() / rate);
+            if(!sleepUntil(target)) {
+                break;
+            }
+
+            // messages sharing a time share one clock tick
+            if(is_clock && !clock_thread.joinable()) {
+                ros::Time clock = schedule.toClock(time);
+                if(clock > last_clock) {
+                    rosgraph_msgs::Clock msg;
+                    msg.clock = clock;
+                    clock_pub.publish(msg);
+                    last_clock = clock;
+                }
+            }
+            if(heads[i].msg) {
+                publishers[heads[i].topic].publish(*heads[i].msg);
+            }
+
+            // messages sharing a nanosecond are told apart by their count,
+            // the merge orders them the same way when playback resumes
+            current_time = time.toNSec();
+            if((int64_t)time.toNSec() == next_time) {
+                ++next_skip;
+            } else {
+                next_time = time.toNSec();
+                next_skip = 1;
+            }
+            if(callback) {
+                callback(time, heads[i].size);
+            }
+
+            if(count > 0 && ++published == count) {
+                break;
+            }
+            if(readers[i]->next(heads[i])) {
+                heap.push(Key(heads[i].time, i));
+            } else {
+                readers[i].reset();
+            }
+            openReaders();
+        }
+
+        if(!is_loop || count > 0) {
+            break;
+        }
+
+        // a pass from the beginning without a message, e.g. with every topic
+        // unchecked, would be repeated forever without publishing anything
+        if(is_empty && start_time <= begin_time) {
+            break;
+        }
+
+        // the bag clock starts over, a wall clock goes on
+        schedule.wall_begin = 0;
+        schedule.elapsed += (end_time - start_time).toNSec();
+        schedule.bag_begin = begin_time.toNSec();
+        ++schedule.loop;
+        if(schedule.wall_anchor.isZero()) {
+            last_clock = ros::Time();
+        }
+        start_time = begin_time;
+        next_time = begin_time.toNSec();
+        next_skip = 0;
+    }
+
+    if(clock_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            schedule.is_done = true;
+        }
+        condition.notify_all();
+        clock_thread.join();
+    }
+    is_playing = false;
+}
+
+void BagPlayer::runClock(ClockSchedule& schedule, const double& frequency)
+{
+    // ticks lie on a fixed grid of wall time, so late wake-ups do not add up,
+    // ticks missed entirely are dropped instead of published in a burst
+    int64_t period = (int64_t)(1e9 / frequency);
+    ros::WallTime tick = ros::WallTime::now();
+    ros::Time last;
+    int loop = schedule.loop;
+    while(true) {
+        int64_t late = (int64_t)(ros::WallTime::now().toNSec() - tick.toNSec());
+        int64_t ticks = late > 0 ? late / period + 1 : 1;
+        tick.fromNSec(tick.toNSec() + ticks * period);
+        if(!sleepUntil(tick, &schedule.is_done)) {
+            break;
+        }
+
+        if(schedule.loop != loop) {
+            loop = schedule.loop;
+            if(schedule.wall_anchor.isZero()) {
+                last = ros::Time();
+            }
+        }
+
+        // the bag time due now, held at the start while subscribers connect
+        ros::Time time;
+        time.fromNSec(schedule.bag_begin);
+        int64_t wall_begin = schedule.wall_begin;
+        if(wall_begin > 0 && (int64_t)tick.toNSec() > wall_begin) {
+            time += ros::Duration(((int64_t)tick.toNSec() - wall_begin) / 1e9 * schedule.rate);
+            time = std::min(time, schedule.end_time);
+        }
+
+        // the clock never stands still or goes back while playing
+        ros::Time clock = schedule.toClock(time);
+        if(!last.isZero() && clock <= last) {
+            clock = last + ros::Duration(0, 1);
+        }
+
+        rosgraph_msgs::Clock msg;
+        msg.clock = clock;
+        clock_pub.publish(msg);
+        last = clock;
+    }
+}
+
+void BagPlayer::updateRange()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    begin_time = ros::Time();
+    end_time = ros::Time();
+    for(size_t i = 0; i < segments.size(); ++i) {
+        ros::Time begin = shift(segments[i].begin_time, offsets[i]);
+        ros::Time end = shift(segments[i].end_time, offsets[i]);
+        if(i == 0 || begin < begin_time) {
+            begin_time = begin;
+        }
+        if(i == 0 || end > end_time) {
+            end_time = end;
+        }
+    }
+}
+
+bool BagPlayer::sleepUntil(const ros::WallTime& time, const std::atomic<bool>* is_done)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!is_stopping && !(is_done && *is_done)) {
+        ros::WallTime now = ros::WallTime::now();
+        if(now >= time) {
+            return true;
+        }
+        condition.wait_for(lock, std::chrono::nanoseconds((time - now).toNSec()));
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,551 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/bag_player_engine.h"
+
+#include <rosbag/view.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace rqt_bag_player {
+
+namespace {
+
+// rosbag record is killed this long after being interrupted without waiting
+const double KillTimeout = 10.0;
+
+// a waiting export looks this often whether it has been cancelled
+const double ExportPollPeriod = 0.1;
+
+// parts written by rosbag record --split, <baseName>_<n>.bag in split order,
+// only the run of consecutive numbers holding part if it is not negative
+QStringList splitParts(const QDir& dir, const QString& baseName, const int& part = -1)
+{
+    QRegularExpression pattern("^" + QRegularExpression::escape(baseName) + "_(\\d+)\\.bag$");
+    std::map<int, QString> parts;
+    for(auto& name : dir.entryList(QStringList() << baseName + "_*.bag", QDir::Files)) {
+        QRegularExpressionMatch match = pattern.match(name);
+        if(match.hasMatch()) {
+            parts[match.captured(1).toInt()] = dir.filePath(name);
+        }
+    }
+
+    // rosbag record --split numbers its parts without gaps, the first ones
+    // may have been rotated away, a gap means parts are missing or the
+    // files only happen to end in a number, so a part opens its own run
+    QStringList fileNames;
+    int previous = -1;
+    for(auto& pair : parts) {
+        if(previous >= 0 && pair.first != previous + 1) {
+            ROS_WARN("Parts %d to %d of %s are missing", previous + 1, pair.first - 1,
+                dir.filePath(baseName).toStdString().c_str());
+            if(part >= 0 && part < pair.first) {
+                break;
+            }
+            if(part >= 0) {
+                fileNames.clear();
+            }
+        }
+        fileNames << pair.second;
+        previous = pair.first;
+    }
+    return fileNames;
+}
+
+// whether the bag written by an export holds no other topics than requested
+bool hasOnlyTopics(const std::string& fileName, const std::vector<std::string>& topics)
+{
+    std::set<std::string> names(topics.begin(), topics.end());
+    try {
+        rosbag::Bag bag(fileName, rosbag::bagmode::Read);
+        rosbag::View view(bag);
+        for(auto& info : view.getConnections()) {
+            if(names.count(info->topic) == 0) {
+                ROS_ERROR("Export %s holds the unrequested topic %s", fileName.c_str(), info->topic.c_str());
+                return false;
+            }
+        }
+    } catch(rosbag::BagException& ex) {
+        ROS_ERROR("Failed to read export %s: %s", fileName.c_str(), ex.what());
+        return false;
+    }
+    return true;
+}
+
+QStringList toStringList(const std::vector<std::string>& strings)
+{
+    QStringList list;
+    for(auto& string : strings) {
+        list << QString::fromStdString(string);
+    }
+    return list;
+}
+
+}
+
+BagPlayerEngine::BagPlayerEngine()
+    : export_generation(0)
+    , play_rate(1.0)
+    , begin_nsec(0)
+    , play_position(0.0)
+    , position_period(0.1)
+    , statistics_period(1.0)
+    , statistics{ros::Time(), 0, 0, 0.0, 0.0}
+    , last_messages(0)
+    , last_bytes(0)
+{
+    player.setPublishCallback([this](const ros::Time& time, const uint32_t& size){ on_published(time, size); });
+}
+
+BagPlayerEngine::~BagPlayerEngine()
+{
+    close();
+}
+
+std::vector<std::string> BagPlayerEngine::expandFiles(const std::string& fileName)
+{
+    QFileInfo info(QString::fromStdString(fileName));
+    QStringList fileNames;
+    if(info.suffix() == "bagset") {
+        QFile file(info.filePath());
+        if(file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream stream(&file);
+            while(!stream.atEnd()) {
+                QString line = stream.readLine().trimmed();
+                if(line.isEmpty()) {
+                    continue;
+                }
+
+                // recorded with --split, the parts are <name>_<n>.bag
+                QFileInfo part(info.dir(), line);
+                if(part.exists()) {
+                    fileNames << part.absoluteFilePath();
+                } else {
+                    fileNames << splitParts(part.dir(), part.completeBaseName());
+                }
+            }
+        }
+    } else {
+        // a part of a split recording opens the whole set as one timeline
+        QRegularExpressionMatch match = QRegularExpression("^(.+)_(\\d+)$").match(info.completeBaseName());
+        if(match.hasMatch()) {
+            fileNames = splitParts(info.dir(), match.captured(1), match.captured(2).toInt());
+        }
+        if(!fileNames.contains(info.absoluteFilePath())) {
+            fileNames = QStringList() << info.filePath();
+        }
+    }
+
+    std::vector<std::string> files;
+    for(auto& name : fileNames) {
+        files.push_back(name.toStdString());
+    }
+    return files;
+}
+
+bool BagPlayerEngine::load(const std::vector<std::string>& fileNames)
+{
+    std::vector<std::string> expanded = fileNames.size() == 1 ? expandFiles(fileNames.front()) : fileNames;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    files.clear();
+    if(!player.open(expanded)) {
+        return false;
+    }
+    files = expanded;
+
+    std::vector<std::string> names;
+    for(auto& topic : player.topics()) {
+        names.push_back(topic.first);
+    }
+    player.setTopics(names);
+    begin_nsec = player.beginTime().toNSec();
+    play_position = 0.0;
+    return true;
+}
+
+bool BagPlayerEngine::load(const std::vector<std::shared_ptr<rosbag::Bag>>& bags)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    files.clear();
+    if(!player.open(bags)) {
+        return false;
+    }
+    for(auto& bag : bags) {
+        files.push_back(bag->getFileName());
+    }
+
+    std::vector<std::string> names;
+    for(auto& topic : player.topics()) {
+        names.push_back(topic.first);
+    }
+    player.setTopics(names);
+    begin_nsec = player.beginTime().toNSec();
+    play_position = 0.0;
+    return true;
+}
+
+void BagPlayerEngine::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.close();
+    files.clear();
+    play_position = 0.0;
+}
+
+bool BagPlayerEngine::isLoaded() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return !files.empty();
+}
+
+std::vector<std::string> BagPlayerEngine::fileNames() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return files;
+}
+
+std::vector<std::pair<std::string, std::string>> BagPlayerEngine::topics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return player.topics();
+}
+
+ros::Time BagPlayerEngine::beginTime() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return player.beginTime();
+}
+
+ros::Time BagPlayerEngine::endTime() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return player.endTime();
+}
+
+double BagPlayerEngine::duration() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (player.endTime() - player.beginTime()).toSec();
+}
+
+std::string BagPlayerEngine::currentFileName() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return player.fileName(player.currentTime());
+}
+
+void BagPlayerEngine::setTopics(const std::vector<std::string>& topics)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setTopics(topics);
+}
+
+void BagPlayerEngine::setRate(const double& rate)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    play_rate = rate > 0.0 ? rate : 1.0;
+    player.setRate(play_rate);
+
+    // the rate is read when playback starts
+    if(player.isPlaying()) {
+        player.resume();
+    }
+}
+
+double BagPlayerEngine::rate() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return play_rate;
+}
+
+void BagPlayerEngine::setLoop(const bool& on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setLoop(on);
+}
+
+void BagPlayerEngine::setPublishClock(const bool& on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setPublishClock(on);
+}
+
+void BagPlayerEngine::setClockFrequency(const double& frequency)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setClockFrequency(frequency);
+}
+
+void BagPlayerEngine::setClockOffset(const double& offset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setClockOffset(ros::Duration(offset));
+}
+
+void BagPlayerEngine::setClockWallTime(const bool& on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setClockWallTime(on);
+}
+
+void BagPlayerEngine::setOffset(const size_t& index, const double& offset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setOffset(index, ros::Duration(offset));
+    begin_nsec = player.beginTime().toNSec();
+}
+
+double BagPlayerEngine::offset(const size_t& index) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return player.offset(index).toSec();
+}
+
+double BagPlayerEngine::estimateOffset(const size_t& index, const size_t& reference, const std::string& topic) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return player.estimateOffset(index, reference, topic).toSec();
+}
+
+void BagPlayerEngine::setPrefix(const size_t& index, const std::string& prefix)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.setPrefix(index, prefix);
+}
+
+bool BagPlayerEngine::play()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(files.empty()) {
+        return false;
+    }
+    if(!player.isPlaying()) {
+        player.resume();
+    }
+    return player.isPlaying();
+}
+
+void BagPlayerEngine::pause()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    player.stop();
+}
+
+bool BagPlayerEngine::isPlaying() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return player.isPlaying();
+}
+
+bool BagPlayerEngine::seek(const double& time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(files.empty() || time < 0.0 || time > (player.endTime() - player.beginTime()).toSec()) {
+        return false;
+    }
+    player.seek(time);
+    play_position = time;
+    return true;
+}
+
+bool BagPlayerEngine::step(const size_t& count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(files.empty()) {
+        return false;
+    }
+    player.step(count);
+    return true;
+}
+
+double BagPlayerEngine::position() const
+{
+    return play_position;
+}
+
+ros::Time BagPlayerEngine::currentTime() const
+{
+    return player.currentTime();
+}
+
+bool BagPlayerEngine::startRecord(const std::string& fileName, const std::vector<std::string>& topics,
+    const std::vector<std::string>& options, const int& splitSize, const double& timeout)
+{
+    if(topics.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!recorder.record(QString::fromStdString(fileName), toStringList(topics), toStringList(options), splitSize)) {
+        return false;
+    }
+    return timeout <= 0.0 || Recorder::waitForBags(QStringList() << QString::fromStdString(fileName), true, timeout);
+}
+
+std::string BagPlayerEngine::startNode(const std::string& program, const std::vector<std::string>& arguments, const std::string& prefix)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return recorder.startNode(QString::fromStdString(program), toStringList(arguments), QString::fromStdString(prefix)).toStdString();
+}
+
+bool BagPlayerEngine::stopRecord(const double& timeout)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(timeout <= 0.0) {
+        recorder.stop(KillTimeout, false);
+        return true;
+    }
+
+    // rosbag record has closed its bags once it has exited
+    return recorder.stop(timeout);
+}
+
+bool BagPlayerEngine::isRecording() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return recorder.isRunning();
+}
+
+bool BagPlayerEngine::exportBag(const std::string& fileName, const std::vector<std::string>& topics, const bool& wait)
+{
+    std::vector<std::string> inputs = fileNames();
+    if(inputs.empty() || topics.empty()) {
+        return false;
+    }
+
+    // the expression is evaluated by python, each topic is compared on its own
+    QStringList conditions;
+    for(auto& topic : topics) {
+        QString name = QString::fromStdString(topic);
+        name.replace("\\", "\\\\").replace("'", "\\'");
+        conditions << QString("topic == '%1'").arg(name);
+    }
+    QString option = conditions.join(" or ");
+
+    // exports that have exited are forgotten before new ones are added
+    if(!wait) {
+        std::lock_guard<std::mutex> lock(mutex);
+        export_ids.erase(std::remove_if(export_ids.begin(), export_ids.end(),
+            [&](const int& id){ return !exports.isRunning(id); }), export_ids.end());
+        exports.clearFinished();
+    }
+
+    // rosbag filter takes a single input, a bag set is exported file by file,
+    // a cancel in between stops the files not started yet
+    int generation = export_generation;
+    bool result = true;
+    for(size_t i = 0; i < inputs.size(); ++i) {
+        if(generation != export_generation) {
+            result = false;
+            break;
+        }
+
+        QString outputName = QString::fromStdString(fileName);
+        if(inputs.size() > 1) {
+            QFileInfo info(outputName);
+            outputName = info.dir().filePath(QString("%1_%2.bag").arg(info.completeBaseName()).arg(i));
+        }
+
+        QStringList arguments;
+        arguments << "filter" << QString::fromStdString(inputs[i]) << outputName;
+        arguments << option;
+        int id = exports.start("rosbag", arguments);
+        if(id < 0) {
+            result = false;
+        } else if(wait) {
+            while(!exports.wait(id, ExportPollPeriod)) {
+                if(generation != export_generation) {
+                    exports.stop(id, 1.0);
+                    break;
+                }
+            }
+            result = exports.exitCode(id) == 0 && hasOnlyTopics(outputName.toStdString(), topics) && result;
+        } else {
+            std::lock_guard<std::mutex> lock(mutex);
+            export_ids.push_back(id);
+        }
+    }
+    if(wait) {
+        exports.clearFinished();
+    }
+    return result;
+}
+
+double BagPlayerEngine::exportProgress() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    double progress = 0.0;
+    bool is_running = false;
+    for(auto& id : export_ids) {
+        is_running = is_running || exports.isRunning(id);
+        progress += exports.isRunning(id) ? qMax(0.0, exports.progress(id)) : 100.0;
+    }
+    return is_running ? progress / export_ids.size() : -1.0;
+}
+
+bool BagPlayerEngine::cancelExport()
+{
+    ++export_generation;
+    std::lock_guard<std::mutex> lock(mutex);
+    export_ids.clear();
+    bool result = exports.stopAll(1.0);
+    exports.clearFinished();
+    return result;
+}
+
+void BagPlayerEngine::setPositionCallback(const std::function<void(const double&)>& callback, const double& period)
+{
+    std::lock_guard<std::mutex> lock(callback_mutex);
+    position_callback = callback;
+    position_period = period;
+}
+
+void BagPlayerEngine::setStatisticsCallback(const std::function<void(const Statistics&)>& callback, const double& period)
+{
+    std::lock_guard<std::mutex> lock(callback_mutex);
+    statistics_callback = callback;
+    statistics_period = period;
+}
+
+void BagPlayerEngine::on_published(const ros::Time& time, const uint32_t& size)
+{
+    // the engine mutex may be held by a caller waiting for this thread,
+    // only the callback state is locked here
+    play_position = std::max(0.0, (int64_t)(time.toNSec() - begin_nsec) / 1e9);
+
+    std::lock_guard<std::mutex> lock(callback_mutex);
+    statistics.time = time;
+    ++statistics.messages;
+    statistics.bytes += size;
+
+    ros::WallTime now = ros::WallTime::now();
+    if(position_callback && (now - last_position).toSec() >= position_period) {
+        last_position = now;
+        position_callback(play_position);
+    }
+
+    double elapsed = (now - last_statistics).toSec();
+    if(statistics_callback && elapsed >= statistics_period) {
+        if(!last_statistics.isZero()) {
+            statistics.message_rate = (statistics.messages - last_messages) / elapsed;
+            statistics.bandwidth = (statistics.bytes - last_bytes) / elapsed;
+        }
+        last_statistics = now;
+        last_messages = statistics.messages;
+        last_bytes = statistics.bytes;
+        statistics_callback(statistics);
+    }
+}
+
+}
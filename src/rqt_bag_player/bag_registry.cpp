@@ -0,0 +1,137 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/bag_registry.h"
+
+#include <rosbag/view.h>
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QString>
+
+#include <set>
+
+namespace rqt_bag_player {
+
+namespace {
+
+// bag indexes are spread over the file, more readers than this only make
+// a spinning disk seek
+const int DefaultMaxThreadCount = 4;
+
+}
+
+BagRegistry::BagRegistry()
+{
+    pool.setMaxThreadCount(DefaultMaxThreadCount);
+}
+
+BagRegistry& BagRegistry::instance()
+{
+    static BagRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<rosbag::Bag> BagRegistry::open(const std::string& fileName)
+{
+    QFileInfo info(QString::fromStdString(fileName));
+    std::string key = info.exists() ? info.canonicalFilePath().toStdString() : fileName;
+    qint64 size = info.size();
+    qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if(it != entries.end() && it->second.size == size && it->second.mtime == mtime) {
+            std::shared_ptr<rosbag::Bag> bag = it->second.bag.lock();
+            if(bag) {
+                return bag;
+            }
+        }
+    }
+
+    // the index is read without the lock, so several bags open in parallel
+    std::shared_ptr<rosbag::Bag> bag = std::make_shared<rosbag::Bag>(fileName);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    removeExpired();
+    auto it = entries.find(key);
+    if(it != entries.end() && it->second.size == size && it->second.mtime == mtime) {
+        // opened by another thread meanwhile, its copy is shared
+        std::shared_ptr<rosbag::Bag> opened = it->second.bag.lock();
+        if(opened) {
+            return opened;
+        }
+    }
+
+    Entry& entry = entries[key];
+    entry.bag = bag;
+    entry.index.reset();
+    entry.size = size;
+    entry.mtime = mtime;
+    return bag;
+}
+
+std::shared_ptr<const BagRegistry::Index> BagRegistry::index(const std::shared_ptr<rosbag::Bag>& bag)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* entry = find(bag);
+        if(entry && entry->index) {
+            return entry->index;
+        }
+    }
+
+    // only the index held in memory is read
+    auto index = std::make_shared<Index>();
+    rosbag::View view(*bag);
+    index->begin_time = view.getBeginTime();
+    index->end_time = view.getEndTime();
+    std::set<std::string> names;
+    for(auto& info : view.getConnections()) {
+        if(names.insert(info->topic).second) {
+            index->topics.push_back(std::make_pair(info->topic, info->datatype));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = find(bag);
+    if(entry) {
+        if(!entry->index) {
+            entry->index = index;
+        }
+        return entry->index;
+    }
+    return index;
+}
+
+std::shared_ptr<rosbag::Bag> BagRegistry::openReader(const std::shared_ptr<rosbag::Bag>& bag)
+{
+    // the handle reads its own copy of the index, the shared one is only
+    // kept for the metadata
+    return std::make_shared<rosbag::Bag>(bag->getFileName());
+}
+
+BagRegistry::Entry* BagRegistry::find(const std::shared_ptr<rosbag::Bag>& bag)
+{
+    for(auto& pair : entries) {
+        if(pair.second.bag.lock() == bag) {
+            return &pair.second;
+        }
+    }
+    return nullptr;
+}
+
+void BagRegistry::removeExpired()
+{
+    for(auto it = entries.begin(); it != entries.end();) {
+        if(it->second.bag.expired()) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}
@@ -0,0 +1,164 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/bag_scanner.h"
+#include "rqt_bag_player/bag_registry.h"
+
+#include <ros/console.h>
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+#include <functional>
+
+namespace rqt_bag_player {
+
+namespace {
+
+// bag indexes are spread over the file, more readers than this only make
+// a spinning disk seek
+const int DefaultMaxConcurrency = 4;
+
+class ScanTask : public QRunnable
+{
+public:
+    ScanTask(const std::function<void()>& function)
+        : function(function) { }
+
+    virtual void run() override { function(); }
+
+private:
+    std::function<void()> function;
+};
+
+}
+
+BagScanner::BagScanner(QObject* parent)
+    : QObject(parent)
+    , generation(0)
+    , total(0)
+    , pending(0)
+    , max_concurrency(DefaultMaxConcurrency)
+{
+
+}
+
+BagScanner::~BagScanner()
+{
+    cancel();
+
+    // queued tasks of this scanner still refer to it
+    QMutexLocker locker(&mutex);
+    while(pending > 0) {
+        condition.wait(&mutex);
+    }
+}
+
+void BagScanner::setMaxConcurrency(const int& count)
+{
+    QMutexLocker locker(&mutex);
+    max_concurrency = qBound(1, count, qMax(1, QThread::idealThreadCount()));
+    startNext();
+}
+
+void BagScanner::scan(const QStringList& fileNames)
+{
+    cancel();
+
+    if(fileNames.isEmpty()) {
+        emit finished();
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    total = fileNames.size();
+    queue.assign(fileNames.begin(), fileNames.end());
+    startNext();
+}
+
+void BagScanner::startNext()
+{
+    // the pool is shared, so this scanner hands it no more files than its
+    // own limit and queues the rest itself
+    while(pending < max_concurrency && !queue.empty()) {
+        QString fileName = queue.front();
+        queue.pop_front();
+        int current = generation;
+        ++pending;
+        BagRegistry::instance().threadPool()->start(new ScanTask([=](){
+            scanFile(fileName, current);
+
+            QMutexLocker locker(&mutex);
+            --pending;
+            startNext();
+            condition.wakeAll();
+        }));
+    }
+}
+
+void BagScanner::cancel()
+{
+    // tasks of an older generation return without publishing their result,
+    // the pool is shared, so they are left to drain instead of cleared
+    QMutexLocker locker(&mutex);
+    ++generation;
+    queue.clear();
+    results.clear();
+    total = 0;
+}
+
+BagScanner::Result BagScanner::result(const QString& fileName) const
+{
+    QMutexLocker locker(&mutex);
+    auto it = results.find(fileName);
+    return it != results.end() ? it->second : Result();
+}
+
+bool BagScanner::isFinished() const
+{
+    QMutexLocker locker(&mutex);
+    return (int)results.size() == total;
+}
+
+void BagScanner::scanFile(const QString& fileName, const int& generation)
+{
+    if(generation != this->generation) {
+        return;
+    }
+
+    // a bag opened by another window is taken over with its index
+    Result result;
+    try {
+        BagRegistry& registry = BagRegistry::instance();
+        result.bag = registry.open(fileName.toStdString());
+
+        std::shared_ptr<const BagRegistry::Index> index = registry.index(result.bag);
+        result.begin_time = index->begin_time;
+        result.end_time = index->end_time;
+        result.topics = index->topics;
+    } catch(rosbag::BagException& ex) {
+        ROS_WARN("Failed to scan %s: %s", fileName.toStdString().c_str(), ex.what());
+        result = Result();
+    }
+
+    int done;
+    int total;
+    {
+        QMutexLocker locker(&mutex);
+        if(generation != this->generation) {
+            return;
+        }
+        results[fileName] = result;
+        done = results.size();
+        total = this->total;
+    }
+
+    emit scanned(fileName, done, total);
+    if(done == total) {
+        emit finished();
+    }
+}
+
+}
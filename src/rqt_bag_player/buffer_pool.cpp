@@ -0,0 +1,130 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/buffer_pool.h"
+
+#include <algorithm>
+
+namespace rqt_bag_player {
+
+namespace {
+
+const size_t MinBufferSize = 256;
+const size_t SlabSize = 1024 * 1024;
+
+// keeps the data behind the header aligned for any message type
+const size_t HeaderSize = 64;
+
+}
+
+struct BufferPool::Header
+{
+    BufferPool* pool;
+    Header* next;
+    int index;
+    size_t capacity;
+};
+
+void BufferPool::Deleter::operator()(uint8_t* data) const
+{
+    if(data) {
+        Header* header = (Header*)(data - HeaderSize);
+        if(header->pool) {
+            header->pool->release(header);
+        } else {
+            delete[] (uint8_t*)header;
+        }
+    }
+}
+
+BufferPool::BufferPool()
+{
+    static_assert(sizeof(Header) <= HeaderSize, "header does not fit in front of the data");
+    for(auto& sizeClass : classes) {
+        sizeClass.free_list = nullptr;
+    }
+}
+
+BufferPool::~BufferPool()
+{
+
+}
+
+BufferPool::BufferPtr BufferPool::allocate(const size_t& size)
+{
+    int index = 0;
+    while(index < NumClasses && (MinBufferSize << index) < size) {
+        ++index;
+    }
+
+    if(index == NumClasses) {
+        // larger than the largest class, not worth keeping around
+        Header* header = (Header*)new uint8_t[HeaderSize + size];
+        header->pool = nullptr;
+        header->next = nullptr;
+        header->index = -1;
+        header->capacity = size;
+        return BufferPtr((uint8_t*)header + HeaderSize);
+    }
+
+    SizeClass& sizeClass = classes[index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    if(!sizeClass.free_list) {
+        grow(index);
+    }
+
+    Header* header = sizeClass.free_list;
+    sizeClass.free_list = header->next;
+    header->next = nullptr;
+    return BufferPtr((uint8_t*)header + HeaderSize);
+}
+
+size_t BufferPool::capacity(const uint8_t* data)
+{
+    const Header* header = (const Header*)(data - HeaderSize);
+    return header->capacity;
+}
+
+size_t BufferPool::reservedBytes() const
+{
+    size_t bytes = 0;
+    for(int i = 0; i < NumClasses; ++i) {
+        SizeClass& sizeClass = const_cast<SizeClass&>(classes[i]);
+        std::lock_guard<std::mutex> lock(sizeClass.mutex);
+        size_t stride = HeaderSize + (MinBufferSize << i);
+        size_t count = std::max(SlabSize / stride, (size_t)1);
+        bytes += sizeClass.slabs.size() * count * stride;
+    }
+    return bytes;
+}
+
+void BufferPool::release(Header* header)
+{
+    SizeClass& sizeClass = classes[header->index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    header->next = sizeClass.free_list;
+    sizeClass.free_list = header;
+}
+
+void BufferPool::grow(const int& index)
+{
+    // small classes share one slab, large ones get a slab per buffer
+    size_t capacity = MinBufferSize << index;
+    size_t stride = HeaderSize + capacity;
+    size_t count = std::max(SlabSize / stride, (size_t)1);
+
+    SizeClass& sizeClass = classes[index];
+    sizeClass.slabs.emplace_back(new uint8_t[count * stride]);
+    uint8_t* slab = sizeClass.slabs.back().get();
+    for(size_t i = 0; i < count; ++i) {
+        Header* header = (Header*)(slab + i * stride);
+        header->pool = this;
+        header->index = index;
+        header->capacity = capacity;
+        header->next = sizeClass.free_list;
+        sizeClass.free_list = header;
+    }
+}
+
+}
@@ -0,0 +1,138 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/disk_watchdog.h"
+
+#include <sys/statvfs.h>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QTimer>
+
+namespace rqt_bag_player {
+
+DiskWatchdog::DiskWatchdog(QObject* parent)
+    : QObject(parent)
+    , threshold(0)
+    , free_space(-1)
+    , last_bytes(0)
+    , last_msecs(0)
+    , write_rate(0.0)
+    , is_crossed(false)
+{
+    timer = new QTimer(this);
+    timer->setInterval(1000);
+    connect(timer, &QTimer::timeout, [&](){ on_timer_timeout(); });
+}
+
+void DiskWatchdog::start(const QString& dir, const QString& baseName)
+{
+    this->dir = dir;
+    this->baseName = baseName;
+    free_space = freeSpace(dir);
+    last_bytes = writtenBytes();
+    last_msecs = QDateTime::currentMSecsSinceEpoch();
+    write_rate = 0.0;
+    is_crossed = false;
+    timer->start();
+}
+
+void DiskWatchdog::stop()
+{
+    timer->stop();
+}
+
+double DiskWatchdog::remainingTime() const
+{
+    if(free_space < 0 || write_rate <= 0.0) {
+        return -1.0;
+    }
+    return qMax(free_space - threshold, (qint64)0) / write_rate;
+}
+
+bool DiskWatchdog::removeOldestFile()
+{
+    // splits are named <baseName>[_<compression>][_<transport>]_<n>.bag, the
+    // one being written ends with .active and is never listed, the pre-roll
+    // capture and unsplit outputs do not end in a number and are kept
+    QRegularExpression pattern("^" + QRegularExpression::escape(baseName) + "(_[A-Za-z][A-Za-z0-9]*)*_\\d+\\.bag$");
+    QDir d(dir);
+    QFileInfoList files = d.entryInfoList(QStringList() << baseName + "_*.bag",
+        QDir::Files, QDir::Time | QDir::Reversed);
+    QString oldest;
+    for(auto& file : files) {
+        if(pattern.match(file.fileName()).hasMatch() && !file.fileName().contains("_preroll")) {
+            oldest = file.absoluteFilePath();
+            break;
+        }
+    }
+    if(oldest.isEmpty()) {
+        return false;
+    }
+    bool removed = QFile::remove(oldest);
+    if(removed) {
+        is_crossed = false;
+    }
+    return removed;
+}
+
+qint64 DiskWatchdog::freeSpace(const QString& dir)
+{
+    struct statvfs stat;
+    if(statvfs(dir.toLocal8Bit().constData(), &stat) != 0) {
+        return -1;
+    }
+    return (qint64)stat.f_bavail * (qint64)stat.f_frsize;
+}
+
+void DiskWatchdog::on_timer_timeout()
+{
+    free_space = freeSpace(dir);
+
+    qint64 bytes = writtenBytes();
+    qint64 msecs = QDateTime::currentMSecsSinceEpoch();
+    if(msecs > last_msecs && bytes >= last_bytes) {
+        // smooth the rate so a single chunk flush does not make the estimate jump
+        double rate = (bytes - last_bytes) * 1000.0 / (msecs - last_msecs);
+        write_rate = write_rate > 0.0 ? 0.8 * write_rate + 0.2 * rate : rate;
+    }
+    last_bytes = bytes;
+    last_msecs = msecs;
+
+    QString message = QString("Free: %1 MB").arg(free_space / (1024 * 1024));
+    double remaining = remainingTime();
+    if(remaining >= 0.0) {
+        int secs = (int)remaining;
+        message += QString("  Remaining: %1:%2:%3")
+            .arg(secs / 3600)
+            .arg((secs / 60) % 60, 2, 10, QChar('0'))
+            .arg(secs % 60, 2, 10, QChar('0'));
+    }
+    emit statusChanged(message);
+
+    if(free_space >= 0 && free_space < threshold) {
+        if(!is_crossed) {
+            is_crossed = true;
+            emit thresholdCrossed();
+        }
+    } else {
+        is_crossed = false;
+    }
+}
+
+qint64 DiskWatchdog::writtenBytes() const
+{
+    qint64 bytes = 0;
+    QDir d(dir);
+    QFileInfoList files = d.entryInfoList(QStringList() << baseName + "*.bag*", QDir::Files);
+    for(auto& info : files) {
+        bytes += info.size();
+    }
+    return bytes;
+}
+
+}
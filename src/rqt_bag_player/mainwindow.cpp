@@ -3,35 +3,109 @@
 */
 
 #include "rqt_bag_player/mainwindow.h"
+#include "rqt_bag_player/bag_library.h"
+#include "rqt_bag_player/bag_player_engine.h"
+#include "rqt_bag_player/bag_scanner.h"
+#include "rqt_bag_player/disk_watchdog.h"
+#include "rqt_bag_player/process_supervisor.h"
+#include "rqt_bag_player/recorder.h"
+#include "rqt_bag_player/service_server.h"
+#include "rqt_bag_player/topic_monitor.h"
 
 #include <ros/ros.h>
-#include <rosbag/bag.h>
-#include <rosbag/view.h>
-#include <rosgraph_msgs/Clock.h>
 
 #include <QAction>
 #include <QBoxLayout>
 #include <QCheckBox>
+#include <QComboBox>
+#include <QDateTime>
+#include <QDir>
 #include <QDialog>
 #include <QDialogButtonBox>
+#include <QDockWidget>
 #include <QDoubleSpinBox>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFile>
 #include <QGridLayout>
 #include <QLabel>
+#include <QLineEdit>
+#include <QMap>
+#include <QPair>
 #include <QMenu>
-#include <QProcess>
+#include <QPushButton>
+#include <QRegularExpression>
 #include <QSlider>
+#include <QSpinBox>
+#include <QStatusBar>
 #include <QStringList>
+#include <QTextStream>
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
 #include <QTimer>
 #include <QToolBar>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace rqt_bag_player {
 
+namespace {
+
+// rosbag record is given this long to write its index on shutdown
+const double RecordStopTimeout = 5.0;
+
+// the pre-roll capture goes on this long after rosbag record has opened
+// its bags, so it is connected to the publishers, and is closed after the
+// timeout if it never does
+const qint64 HandoverMargin = 500;
+const qint64 HandoverTimeout = 10000;
+
+// stopped recorders are killed after ten seconds, their bags are closed by then
+const qint64 TrimTimeout = 15000;
+
+// the recorded outputs are given this long to connect before playback starts
+const double PlayRecordConnectTimeout = 2.0;
+
+// lists come back from a perspective as a single string when they hold one item
+QStringList toStringList(const QVariant& value)
+{
+    QStringList list = value.toStringList();
+    list.removeAll(QString());
+    return list;
+}
+
+QStringList uncheckedTopics(const QTreeWidget* tree)
+{
+    QStringList names;
+    for(int i = 0; i < tree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* item = tree->topLevelItem(i);
+        if(item->checkState(0) == Qt::Unchecked) {
+            names << item->text(0);
+        }
+    }
+    return names;
+}
+
+std::vector<std::string> toStdVector(const QStringList& list)
+{
+    std::vector<std::string> strings;
+    for(auto& string : list) {
+        strings.push_back(string.toStdString());
+    }
+    return strings;
+}
+
+}
+
 class PlayerConfigDialog : public QDialog
 {
 public:
@@ -41,17 +115,99 @@ public:
     bool isLoopChecked() const { return loopCheck->isChecked(); }
     void setClockChecked(const bool& checked) { clockCheck->setChecked(checked); }
     bool isClockChecked() const { return clockCheck->isChecked(); }
+    void setClockFrequency(const double& frequency) { clockFrequencySpin->setValue(frequency); }
+    double clockFrequency() const { return clockFrequencySpin->value(); }
+    void setClockOffset(const double& offset) { clockOffsetSpin->setValue(offset); }
+    double clockOffset() const { return clockOffsetSpin->value(); }
+    void setClockWallTimeChecked(const bool& checked) { wallTimeCheck->setChecked(checked); }
+    bool isClockWallTimeChecked() const { return wallTimeCheck->isChecked(); }
     void setRate(const double& rate) { rateSpin->setValue(rate); }
     double rate() const { return rateSpin->value(); }
+    void setComparePrefix(const QString& prefix) { prefixLine->setText(prefix); }
+    QString comparePrefix() const { return prefixLine->text().trimmed(); }
 
 private:
 
+    QLineEdit* prefixLine;
     QCheckBox* loopCheck;
     QCheckBox* clockCheck;
+    QCheckBox* wallTimeCheck;
+    QDoubleSpinBox* clockFrequencySpin;
+    QDoubleSpinBox* clockOffsetSpin;
     QDoubleSpinBox* rateSpin;
     QDialogButtonBox* buttonBox;
 };
 
+class OffsetDialog : public QDialog
+{
+public:
+    OffsetDialog(const QStringList& fileNames, const QStringList& topics, QWidget* parent = nullptr);
+
+    void setOffset(const int& index, const double& offset) { offsetSpins[index]->setValue(offset); }
+    double offset(const int& index) const { return offsetSpins[index]->value(); }
+
+    // called with the bag index and the shared topic, returns the offset
+    // aligning that bag to the first one
+    void setEstimator(const std::function<double(int, const QString&)>& estimator) { this->estimator = estimator; }
+
+private:
+    void estimate();
+
+    QList<QDoubleSpinBox*> offsetSpins;
+    QComboBox* topicCombo;
+    QDialogButtonBox* buttonBox;
+    std::function<double(int, const QString&)> estimator;
+};
+
+class RecorderConfigDialog : public QDialog
+{
+public:
+    enum DiskFullAction { Stop, Rotate };
+
+    RecorderConfigDialog(QWidget* parent = nullptr);
+
+    void setDirectories(const QStringList& dirs) { dirLine->setText(dirs.join(";")); }
+    QStringList directories() const { return dirLine->text().split(";", QString::SkipEmptyParts); }
+    void setMinFreeSpace(const int& megabytes) { freeSpin->setValue(megabytes); }
+    int minFreeSpace() const { return freeSpin->value(); }
+    void setSplitSize(const int& megabytes) { splitSpin->setValue(megabytes); }
+    int splitSize() const { return splitSpin->value(); }
+    void setThreadCount(const int& count) { threadSpin->setValue(count); }
+    int threadCount() const { return threadSpin->value(); }
+    void setPreroll(const double& seconds) { prerollSpin->setValue(seconds); }
+    double preroll() const { return prerollSpin->value(); }
+    void setQuantizationBits(const int& bits) { quantizationSpin->setValue(bits); }
+    int quantizationBits() const { return quantizationSpin->value(); }
+    void setDiskFullAction(const int& action) { actionCombo->setCurrentIndex(action); }
+    int diskFullAction() const { return actionCombo->currentIndex(); }
+
+private:
+    void browse();
+
+    QLineEdit* dirLine;
+    QSpinBox* freeSpin;
+    QSpinBox* splitSpin;
+    QSpinBox* threadSpin;
+    QDoubleSpinBox* prerollSpin;
+    QSpinBox* quantizationSpin;
+    QComboBox* actionCombo;
+    QDialogButtonBox* buttonBox;
+};
+
+struct RecordOption
+{
+    // "png" or "jpeg" to transcode sensor_msgs/Image, "draco" to compress
+    // sensor_msgs/PointCloud2, empty to record raw
+    QString encoding;
+
+    // "lz4", "bz2", "auto" to choose from a sampled compression ratio,
+    // empty to record uncompressed
+    QString compression;
+
+    // "tcpnodelay" or "udp", empty for plain tcp
+    QString transport;
+};
+
 class MainWindow::Impl
 {
 public:
@@ -60,21 +216,60 @@ public:
     Impl(MainWindow* self);
 
     void open();
+    void openFolder();
+    void compare();
     void save();
     void record(const bool& checked);
+    void arm(const bool& checked);
     void clickPlay();
     void clickResume();
     void clickStop();
+    void clickPlayRecord();
     void play();
     void stop();
     void config();
+    void recordConfig();
+    void align();
 
     void checkRecord(const bool& checked);
     void checkPlay(const bool& checked);
     void loadFile(const QString& fileName);
+    void loadFolder(const QString& dir);
+    bool openBags();
+    bool restoreBags(const QStringList& fileNames, const QString& databaseName);
+    void applyRestoredOffsets();
+    void cacheBags();
+    QVariantMap saveSettings() const;
+    void restoreSettings(const QVariantMap& settings);
     void saveFile(const QString& fileName);
+    QStringList checkedPlayTopics() const;
+    void startServices();
+    void startDeferred();
+    void createLibrary();
+    BagIndexer* bagIndexer();
+    void shutdown();
+    bool invoke(const std::function<bool(std::string&)>& function, std::string& message);
+    double position() const;
+    void showPosition(const double& value);
+    void startRecorder(const QString& dir, const QString& baseName, const QStringList& topics, const QStringList& options);
+    QStringList recorderArguments(const QString& compression, const QString& transport) const;
+    QString autoCompression(const QString& topic) const;
+    QString startTranscoder(const QString& topic, const QString& encoding);
+    QTreeWidgetItem* findRecordItem(const QString& topic) const;
+    void setEncoding(QTreeWidgetItem* item, const QString& encoding);
+    void setCompression(QTreeWidgetItem* item, const QString& compression);
+    void setTransport(QTreeWidgetItem* item, const QString& transport);
+    void startDecoders();
+    std::vector<QStringList> stripeTopics(const QStringList& topics, const int& numGroups);
+    void updateMonitor();
+    void updateHandover();
+    void trimPreroll();
 
     void on_timer_timeout();
+    void on_masterTimer_timeout();
+    void on_scanner_scanned(const QString& fileName, const int& done, const int& total);
+    void on_scanner_finished();
+    void on_watchdog_thresholdCrossed(DiskWatchdog* watchdog);
     void on_timeSpin_valueChanged(double value);
     void on_timeSlider_valueChanged(int value);
     void on_playTree_customContextMenuRequested(const QPoint& pos);
@@ -83,41 +278,90 @@ public:
     void createActions();
     void createToolBars();
 
-    void clockCallback(const rosgraph_msgs::ClockPtr& msg);
-
     QAction* openAct;
+    QAction* openFolderAct;
+    QAction* compareAct;
     QAction* saveAct;
     QAction* recordAct;
+    QAction* armAct;
     QAction* playAct;
     QAction* resumeAct;
     QAction* stopAct;
+    QAction* playRecordAct;
     QAction* configAct;
+    QAction* alignAct;
+    QAction* libraryAct;
+    QAction* recordConfigAct;
     QAction* checkPlayAct;
     QAction* uncheckPlayAct;
     QAction* checkRecordAct;
     QAction* uncheckRecordAct;
 
     QTimer* timer;
+    QTimer* masterTimer;
+    QElapsedTimer startupTimer;
+    QElapsedTimer handoverTimer;
+    QElapsedTimer handoverOpenTimer;
+    QElapsedTimer trimTimer;
+    QList<DiskWatchdog*> watchdogs;
+    BagPlayerEngine engine;
+    TopicMonitor monitor;
+    ServiceServer services;
+    BagScanner* scanner;
+    BagIndexer* indexer;
+    QDockWidget* libraryDock;
+    BagLibrary* library;
     QTreeWidget* playTree;
     QTreeWidget* recordTree;
     QDoubleSpinBox* beginTimeSpin;
     QDoubleSpinBox* endTimeSpin;
     QDoubleSpinBox* timeSpin;
     QSlider* timeSlider;
-    QString recordNode;
-    QString playNode;
-    QString filePath;
+    QString recordBaseName;
+    QStringList recordBags;
+    QString prerollFile;
+    QStringList handoverBags;
+    ProcessSupervisor decoders;
+    QStringList filePaths;
+    QStringList scanPaths;
+    QStringList restoredRecordUnchecked;
+    QList<double> restoredOffsets;
+    QString playingFile;
+    QString comparePrefix;
+    QString serviceNamespace;
+    QStringList recordDirs;
+    QMap<QString, RecordOption> recordOptions;
 
-    ros::NodeHandle n;
-    ros::Subscriber clock_sub;
     ros::Time begin_time;
     ros::Time end_time;
 
     bool is_recording;
+    bool is_armed;
     bool is_playing;
+    bool is_play_recording;
+    bool is_comparing;
+    bool is_exporting;
+    bool is_restoring;
+    bool is_position_changed;
+    bool is_showing_position;
+    bool is_handing_over;
+    bool is_trim_pending;
+    bool is_started;
+    std::atomic<bool> is_shut_down;
     bool is_loop_checked;
     bool is_clock_checked;
+    bool is_clock_wall_time;
     double rate;
+    double clock_frequency;
+    double clock_offset;
+    int min_free_space;
+    int split_size;
+    int disk_full_action;
+    int quantization_bits;
+    int thread_count;
+    double preroll;
+    int num_decoders;
+    size_t num_topics;
 };
 
 MainWindow::MainWindow(QWidget* parent)
@@ -129,49 +373,121 @@ MainWindow::MainWindow(QWidget* parent)
 MainWindow::Impl::Impl(MainWindow* self)
     : self(self)
     , is_recording(false)
+    , is_armed(false)
     , is_playing(false)
+    , is_play_recording(false)
+    , is_comparing(false)
+    , is_exporting(false)
+    , is_restoring(false)
+    , is_position_changed(true)
+    , is_showing_position(false)
+    , is_handing_over(false)
+    , is_trim_pending(false)
+    , is_started(false)
+    , is_shut_down(false)
     , is_loop_checked(false)
     , is_clock_checked(true)
+    , is_clock_wall_time(false)
     , rate(1.0)
+    , clock_frequency(0.0)
+    , clock_offset(0.0)
+    , min_free_space(1024)
+    , split_size(0)
+    , disk_full_action(RecorderConfigDialog::Stop)
+    , quantization_bits(14)
+    , thread_count(1)
+    , preroll(5.0)
+    , num_decoders(0)
+    , num_topics(0)
 {
+    startupTimer.start();
+
     QWidget* widget = new QWidget;
     self->setCentralWidget(widget);
 
+    scanner = new BagScanner(self);
+    self->connect(scanner, &BagScanner::scanned, self,
+        [&](const QString& fileName, const int& done, const int& total){ on_scanner_scanned(fileName, done, total); },
+        Qt::QueuedConnection);
+    self->connect(scanner, &BagScanner::finished, self,
+        [&](){ on_scanner_finished(); }, Qt::QueuedConnection);
+
+    // the library opens its database when it is first shown
+    indexer = nullptr;
+    library = nullptr;
+    libraryDock = new QDockWidget("Library", self);
+    libraryDock->hide();
+    self->addDockWidget(Qt::LeftDockWidgetArea, libraryDock);
+
     createActions();
     createToolBars();
 
     self->setWindowTitle("Bag Player");
 
-    clock_sub = n.subscribe("clock", 1000, &Impl::clockCallback, this);
-
-    recordNode.clear();
-    playNode.clear();
-    filePath.clear();
+    filePaths.clear();
+    recordDirs << QDir::currentPath();
+    comparePrefix = "/b";
+    serviceNamespace = "bag_player";
 
+    // the position is polled from the player, a few updates a second are
+    // enough for the slider whatever the message rate or /clock setting
     timer = new QTimer(self);
-    timer->start(0.01);
+    timer->setInterval(50);
     self->connect(timer, &QTimer::timeout, [&](){ on_timer_timeout(); });
 
+    // asking the master is a round trip over the network, topics come and
+    // go far less often than the slider moves
+    masterTimer = new QTimer(self);
+    masterTimer->setInterval(1000);
+    self->connect(masterTimer, &QTimer::timeout, [&](){ on_masterTimer_timeout(); });
+
     playTree = new QTreeWidget;
-    playTree->setHeaderLabels(QStringList() << "Play topics");
+    playTree->setHeaderLabels(QStringList() << "Play topics" << "Type");
     playTree->setContextMenuPolicy(Qt::CustomContextMenu);
     self->connect(playTree, &QTreeWidget::customContextMenuRequested,
         [&](QPoint pos){ on_playTree_customContextMenuRequested(pos); });
 
     recordTree = new QTreeWidget;
-    recordTree->setHeaderLabels(QStringList() << "Record topics");
+    recordTree->setHeaderLabels(QStringList() << "Record topics" << "Type" << "Encoding" << "Compression" << "Transport");
     recordTree->setContextMenuPolicy(Qt::CustomContextMenu);
     self->connect(recordTree, &QTreeWidget::customContextMenuRequested,
         [&](QPoint pos){ on_recordTree_customContextMenuRequested(pos); });
+    self->connect(recordTree, &QTreeWidget::itemChanged,
+        [&](QTreeWidgetItem* item, int column){ if(column == 0) { updateMonitor(); } });
 
     auto layout = new QHBoxLayout;
     layout->addWidget(playTree);
     layout->addWidget(recordTree);
     widget->setLayout(layout);
+
+    // the window is shown before the master is asked or services advertised
+    QTimer::singleShot(0, self, [&](){ startDeferred(); });
+    ROS_DEBUG("Bag player widgets created in %lld ms", (long long)startupTimer.elapsed());
+}
+
+QVariantMap MainWindow::saveSettings() const
+{
+    return impl->saveSettings();
+}
+
+void MainWindow::restoreSettings(const QVariantMap& settings)
+{
+    impl->restoreSettings(settings);
+}
+
+void MainWindow::setServiceNamespace(const QString& ns)
+{
+    impl->serviceNamespace = ns;
+}
+
+void MainWindow::shutdown()
+{
+    impl->shutdown();
 }
 
 MainWindow::~MainWindow()
 {
+    impl->shutdown();
     delete impl;
 }
 
@@ -181,12 +497,10 @@ void MainWindow::Impl::open()
         stop();
     }
 
-    timer->stop();
-
     static QString dir = "/home";
     QString fileName = QFileDialog::getOpenFileName(self, "Open File",
         dir,
-        "Bag Files (*.bag);;All Files (*)");
+        "Bag Files (*.bag *.bagset);;All Files (*)");
 
     if(fileName.isEmpty()) {
         return;
@@ -195,17 +509,61 @@ void MainWindow::Impl::open()
         dir = info.absolutePath();
         loadFile(fileName);
     }
+}
+
+void MainWindow::Impl::openFolder()
+{
+    if(is_playing) {
+        stop();
+    }
 
-    timer->start(0.01);
+    static QString dir = "/home";
+    QString folder = QFileDialog::getExistingDirectory(self, "Open Folder", dir);
+    if(!folder.isEmpty()) {
+        dir = folder;
+        loadFolder(folder);
+    }
 }
 
-void MainWindow::Impl::save()
+void MainWindow::Impl::compare()
 {
     if(is_playing) {
         stop();
     }
 
-    timer->stop();
+    static QString dir = "/home";
+    QString fileNameA = QFileDialog::getOpenFileName(self, "Open Bag A", dir, "Bag Files (*.bag);;All Files (*)");
+    if(fileNameA.isEmpty()) {
+        return;
+    }
+    dir = QFileInfo(fileNameA).absolutePath();
+
+    QString fileNameB = QFileDialog::getOpenFileName(self, "Open Bag B", dir, "Bag Files (*.bag);;All Files (*)");
+    if(fileNameB.isEmpty()) {
+        return;
+    }
+    dir = QFileInfo(fileNameB).absolutePath();
+
+    // both bags are read on their own threads and merged by time,
+    // the topics of B are published under the compare prefix
+    scanner->cancel();
+    filePaths = QStringList() << fileNameA << fileNameB;
+    is_comparing = true;
+    is_restoring = false;
+    if(!openBags()) {
+        is_comparing = false;
+        self->statusBar()->showMessage("Failed to open " + fileNameA + " and " + fileNameB);
+        return;
+    }
+    self->statusBar()->showMessage(QString("Comparing %1 with %2 under %3")
+        .arg(QFileInfo(fileNameA).fileName()).arg(QFileInfo(fileNameB).fileName()).arg(comparePrefix));
+}
+
+void MainWindow::Impl::save()
+{
+    if(is_playing) {
+        stop();
+    }
 
     static QString dir = "/home";
     QString fileName = QFileDialog::getSaveFileName(self, "Save File",
@@ -219,8 +577,6 @@ void MainWindow::Impl::save()
         dir = info.absolutePath();
         saveFile(fileName);
     }
-
-    timer->start(0.01);
 }
 
 void MainWindow::Impl::record(const bool& checked)
@@ -231,37 +587,374 @@ void MainWindow::Impl::record(const bool& checked)
     }
 
     if(checked) {
-        if(count > 0) {
-            QStringList arguments;
-            arguments << "record";
+        for(auto& dir : recordDirs) {
+            if(count > 0 && DiskWatchdog::freeSpace(dir) < (qint64)min_free_space * 1024 * 1024) {
+                self->statusBar()->showMessage("Not enough free space in " + dir);
+                count = 0;
+                recordAct->setChecked(false);
+            }
+        }
+
+        if(count > 0 && !recordDirs.isEmpty()) {
+            recordBaseName = QString("record_%1")
+                .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss"));
+
+            // topics sharing compression and transport are written to the same bags
+            QMap<QPair<QString, QString>, QStringList> streams;
             for(int i = 0; i < count; ++i) {
                 QTreeWidgetItem* item = recordTree->topLevelItem(i);
                 if(item->checkState(0) == Qt::Checked) {
-                    arguments << item->text(0);
+                    RecordOption option = recordOptions.value(item->text(0));
+                    if(option.compression == "auto") {
+                        // transcoded topics are compressed already
+                        option.compression = option.encoding.isEmpty() ? autoCompression(item->text(0)) : "";
+                    }
+                    QPair<QString, QString> key(option.compression, option.transport);
+                    if(option.encoding.isEmpty()) {
+                        streams[key] << item->text(0);
+                    } else {
+                        streams[key] << startTranscoder(item->text(0), option.encoding);
+                    }
+                }
+            }
+
+            // the capture of the previous recording is finished first
+            if(is_trim_pending) {
+                trimPreroll();
+            }
+
+            // the armed subscriptions bridge the time rosbag record needs to subscribe
+            QStringList bags;
+            QString prerollName;
+            if(is_armed) {
+                prerollName = QDir(recordDirs.first()).filePath(recordBaseName + "_preroll.bag");
+                if(monitor.startCapture(prerollName.toStdString())) {
+                    bags << prerollName;
+                } else {
+                    prerollName.clear();
                 }
             }
 
-            recordNode = QString("record_%1").arg(ros::Time::now().toNSec());
+            // one rosbag record per directory and stream, each writing its own group of topics
+            for(auto it = streams.begin(); it != streams.end(); ++it) {
+                QString baseName = recordBaseName;
+                if(!it.key().first.isEmpty()) {
+                    baseName += "_" + it.key().first;
+                }
+                if(!it.key().second.isEmpty()) {
+                    baseName += "_" + it.key().second;
+                }
+
+                QStringList arguments = recorderArguments(it.key().first, it.key().second);
+                std::vector<QStringList> groups = stripeTopics(it.value(), recordDirs.size());
+                for(int i = 0; i < recordDirs.size(); ++i) {
+                    if(!groups[i].isEmpty()) {
+                        startRecorder(recordDirs[i], baseName, groups[i], arguments);
+                        bags << QDir(recordDirs[i]).filePath(baseName + ".bag");
+                    }
+                }
+            }
 
-            arguments << QString("__name:=%1").arg(recordNode);
-            QProcess::startDetached("rosbag", arguments);
+            // the descriptor lets the set be opened as one bag
+            if(bags.size() > 1) {
+                QFile file(QDir(recordDirs.first()).filePath(recordBaseName + ".bagset"));
+                if(file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+                    QTextStream stream(&file);
+                    for(auto& bag : bags) {
+                        stream << bag << "\n";
+                    }
+                }
+            }
+            recordBags = bags;
             is_recording = true;
+
+            // the capture is closed from the timer once the recorders are up
+            if(!prerollName.isEmpty()) {
+                prerollFile = prerollName;
+                handoverBags = bags.mid(1);
+                handoverTimer.start();
+                handoverOpenTimer.invalidate();
+                is_handing_over = true;
+                is_trim_pending = true;
+            }
         } else {
             is_recording = false;
         }
     } else {
-        if(is_recording) {
-            QStringList arguments;
-            arguments << "kill" << QString("/%1").arg(recordNode);
-            QProcess::startDetached("rosnode", arguments);
+        monitor.stopCapture();
+        is_handing_over = false;
+        for(auto& watchdog : watchdogs) {
+            watchdog->stop();
+            watchdog->deleteLater();
         }
+        watchdogs.clear();
+
+        engine.stopRecord(0.0);
         is_recording = false;
+        trimTimer.start();
+    }
+}
+
+void MainWindow::Impl::updateHandover()
+{
+    // rosbag record has subscribed once it has opened its bags, the margin
+    // lets it connect to the publishers, what both receive meanwhile is
+    // trimmed from the capture once the recorders have closed their bags
+    if(is_handing_over) {
+        if(!handoverOpenTimer.isValid() && Recorder::waitForBags(handoverBags, true, 0.0)) {
+            handoverOpenTimer.start();
+        }
+        if(handoverOpenTimer.isValid() && handoverOpenTimer.elapsed() >= HandoverMargin) {
+            monitor.stopCapture();
+            is_handing_over = false;
+        } else if(handoverTimer.elapsed() >= HandoverTimeout) {
+            ROS_WARN("rosbag record did not open its bags, the pre-roll capture is closed");
+            monitor.stopCapture();
+            is_handing_over = false;
+        }
+    }
+
+    if(is_trim_pending && !is_recording) {
+        if(Recorder::waitForBags(handoverBags, false, 0.0)) {
+            trimPreroll();
+        } else if(trimTimer.elapsed() >= TrimTimeout) {
+            ROS_WARN("The recorded bags were not closed, %s is left untrimmed", prerollFile.toStdString().c_str());
+            is_trim_pending = false;
+        }
+    }
+}
+
+void MainWindow::Impl::trimPreroll()
+{
+    // messages of an open bag cannot be read, a capture whose recorders
+    // have not closed their bags yet keeps its overlap
+    is_trim_pending = false;
+    if(!Recorder::waitForBags(handoverBags, false, 0.0)) {
+        ROS_WARN("The recorded bags are still open, %s is left untrimmed", prerollFile.toStdString().c_str());
+        return;
+    }
+    TopicMonitor::trimCapture(prerollFile.toStdString(), toStdVector(handoverBags));
+}
+
+void MainWindow::Impl::arm(const bool& checked)
+{
+    is_armed = checked;
+    monitor.setPreroll(is_armed ? preroll : 0.0);
+    updateMonitor();
+}
+
+void MainWindow::Impl::startRecorder(const QString& dir, const QString& baseName, const QStringList& topics, const QStringList& options)
+{
+    engine.startRecord(QDir(dir).filePath(baseName + ".bag").toStdString(), toStdVector(topics), toStdVector(options), split_size, 0.0);
+
+    for(auto& watchdog : watchdogs) {
+        if(watchdog->property("dir").toString() == dir) {
+            return;
+        }
+    }
+
+    DiskWatchdog* watchdog = new DiskWatchdog(self);
+    watchdog->setProperty("dir", dir);
+    self->connect(watchdog, &DiskWatchdog::statusChanged,
+        [=](const QString& message){ self->statusBar()->showMessage(dir + "  " + message); });
+    self->connect(watchdog, &DiskWatchdog::thresholdCrossed,
+        [=](){ on_watchdog_thresholdCrossed(watchdog); });
+    watchdog->setThreshold((qint64)min_free_space * 1024 * 1024);
+    watchdog->start(dir, recordBaseName);
+    watchdogs << watchdog;
+}
+
+QStringList MainWindow::Impl::recorderArguments(const QString& compression, const QString& transport) const
+{
+    QStringList arguments;
+    if(compression == "lz4") {
+        arguments << "--lz4";
+    } else if(compression == "bz2") {
+        arguments << "--bz2";
+    }
+
+    if(transport == "tcpnodelay") {
+        arguments << "--tcpnodelay";
+    } else if(transport == "udp") {
+        arguments << "--udp";
+    }
+    return arguments;
+}
+
+QString MainWindow::Impl::autoCompression(const QString& topic) const
+{
+    // rosbag has no zstd, bz2 takes its place for highly compressible data
+    double ratio = monitor.compressionRatio(topic.toStdString());
+    if(ratio <= 0.0) {
+        return "lz4";
+    } else if(ratio < 1.2) {
+        return "";
+    } else if(ratio < 4.0) {
+        return "lz4";
+    }
+    return "bz2";
+}
+
+QString MainWindow::Impl::startTranscoder(const QString& topic, const QString& encoding)
+{
+    // the republish nodes compress in their own processes, so the encoding
+    // runs in parallel per topic and never blocks rosbag record
+    QString outTopic = QString("%1_%2").arg(topic).arg(encoding);
+    if(encoding == "draco") {
+        // XYZ is quantized to the given number of bits over the cloud's bounding box
+        ros::param::set(QString("%1/draco/quantization_POSITION").arg(outTopic).toStdString(), quantization_bits);
+        ros::param::set(QString("%1/draco/force_quantization").arg(outTopic).toStdString(), true);
+        ros::param::set(QString("%1/draco/encode_speed").arg(outTopic).toStdString(), 7);
+
+        QStringList arguments;
+        arguments << "point_cloud_transport" << "republish";
+        arguments << "raw" << QString("in:=%1").arg(topic);
+        arguments << "draco" << QString("out:=%1").arg(outTopic);
+        engine.startNode("rosrun", toStdVector(arguments), "transcode");
+
+        return outTopic + "/draco";
+    }
+
+    ros::param::set(QString("%1/compressed/format").arg(outTopic).toStdString(), encoding.toStdString());
+    if(encoding == "png") {
+        ros::param::set(QString("%1/compressed/png_level").arg(outTopic).toStdString(), 1);
+    } else {
+        ros::param::set(QString("%1/compressed/jpeg_quality").arg(outTopic).toStdString(), 90);
+    }
+
+    QStringList arguments;
+    arguments << "image_transport" << "republish";
+    arguments << "raw" << QString("in:=%1").arg(topic);
+    arguments << "compressed" << QString("out:=%1").arg(outTopic);
+    engine.startNode("rosrun", toStdVector(arguments), "transcode");
+
+    return outTopic + "/compressed";
+}
+
+void MainWindow::Impl::startDecoders()
+{
+    // topics recorded as <topic>_draco/draco are played back as standard
+    // sensor_msgs/PointCloud2 on <topic>
+    for(int i = 0; i < playTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* item = playTree->topLevelItem(i);
+        QString name = item->text(0);
+        if(item->checkState(0) != Qt::Checked
+            || item->text(1) != "point_cloud_transport/CompressedPointCloud2"
+            || !name.endsWith("_draco/draco")) {
+            continue;
+        }
+
+        QString inTopic = name.left(name.size() - QString("/draco").size());
+        QString outTopic = inTopic.left(inTopic.size() - QString("_draco").size());
+        QString decodeNode = QString("decode_%1_%2").arg(ros::Time::now().toNSec()).arg(num_decoders++);
+
+        QStringList arguments;
+        arguments << "point_cloud_transport" << "republish";
+        arguments << "draco" << QString("in:=%1").arg(inTopic);
+        arguments << "raw" << QString("out:=%1").arg(outTopic);
+        arguments << QString("__name:=%1").arg(decodeNode);
+        if(decoders.start("rosrun", arguments, QRegularExpression()) < 0) {
+            self->statusBar()->showMessage("Failed to start the decoder for " + outTopic);
+        }
+    }
+}
+
+QTreeWidgetItem* MainWindow::Impl::findRecordItem(const QString& topic) const
+{
+    QList<QTreeWidgetItem*> items = recordTree->findItems(topic, Qt::MatchExactly, 0);
+    return items.isEmpty() ? nullptr : items.first();
+}
+
+void MainWindow::Impl::setEncoding(QTreeWidgetItem* item, const QString& encoding)
+{
+    recordOptions[item->text(0)].encoding = encoding;
+    item->setText(2, encoding.isEmpty() ? "raw" : encoding);
+}
+
+void MainWindow::Impl::setCompression(QTreeWidgetItem* item, const QString& compression)
+{
+    bool changed = recordOptions.value(item->text(0)).compression != compression;
+    recordOptions[item->text(0)].compression = compression;
+    item->setText(3, compression.isEmpty() ? "none" : compression);
+    if(changed) {
+        updateMonitor();
+    }
+}
+
+void MainWindow::Impl::setTransport(QTreeWidgetItem* item, const QString& transport)
+{
+    bool changed = recordOptions.value(item->text(0)).transport != transport;
+    recordOptions[item->text(0)].transport = transport;
+    item->setText(4, transport.isEmpty() ? "tcp" : transport);
+    if(changed) {
+        updateMonitor();
+    }
+}
+
+std::vector<QStringList> MainWindow::Impl::stripeTopics(const QStringList& topics, const int& numGroups)
+{
+    std::vector<QStringList> groups(numGroups);
+    if(numGroups == 1) {
+        groups[0] = topics;
+        return groups;
+    }
+
+    // greedy balancing, the heaviest topic goes to the least loaded group
+    std::vector<std::pair<double, QString>> loads;
+    for(auto& topic : topics) {
+        loads.push_back(std::make_pair(monitor.bandwidth(topic.toStdString()), topic));
+    }
+    std::stable_sort(loads.begin(), loads.end(),
+        [](const std::pair<double, QString>& a, const std::pair<double, QString>& b){ return a.first > b.first; });
+
+    std::vector<double> bandwidths(numGroups, 0.0);
+    for(auto& load : loads) {
+        int index = 0;
+        for(int i = 1; i < numGroups; ++i) {
+            if(bandwidths[i] < bandwidths[index]
+                || (bandwidths[i] == bandwidths[index] && groups[i].size() < groups[index].size())) {
+                index = i;
+            }
+        }
+        bandwidths[index] += load.first;
+        groups[index] << load.second;
+    }
+    return groups;
+}
+
+void MainWindow::Impl::updateMonitor()
+{
+    // only checked topics are subscribed: bandwidths are needed to balance
+    // them over several directories, samples for the topics whose
+    // compression is chosen automatically, and all of them are kept
+    // subscribed while armed or recorded alongside playback
+    std::vector<std::string> topics;
+    std::map<std::string, std::string> transports;
+    for(int i = 0; i < recordTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* item = recordTree->topLevelItem(i);
+        if(item->checkState(0) != Qt::Checked) {
+            continue;
+        }
+        QString name = item->text(0);
+        RecordOption option = recordOptions.value(name);
+        if(recordDirs.size() > 1 || option.compression == "auto" || is_armed || is_play_recording) {
+            topics.push_back(name.toStdString());
+            transports[name.toStdString()] = option.transport.toStdString();
+        }
+    }
+
+    monitor.setThreadCount(thread_count);
+    if(topics.empty()) {
+        monitor.clear();
+    } else {
+        monitor.setTopics(topics, transports);
     }
 }
 
 void MainWindow::Impl::clickPlay()
 {
     timeSpin->setValue(0.0);
+    is_position_changed = true;
     play();
 }
 
@@ -283,39 +976,69 @@ void MainWindow::Impl::clickStop()
     stop();
 }
 
-void MainWindow::Impl::play()
+void MainWindow::Impl::clickPlayRecord()
 {
-    if(!filePath.isEmpty()) {
-        QStringList arguments;
-        arguments << "play" << filePath;
-        arguments << "-q";
-
-        if(is_clock_checked) {
-            arguments << "--clock";
-        }
+    if(filePaths.isEmpty() || recordDirs.isEmpty()) {
+        return;
+    }
 
-        arguments << "-r" << QString("%1").arg(rate);
+    if(is_playing) {
+        stop();
+    }
 
-        double start_time = timeSpin->value();
-        arguments << "-s" << QString("%1").arg(start_time);
+    // the outputs are stamped with the player's bag time, so the recorded
+    // bag covers the same time range as the input
+    recordBaseName = QString("record_%1")
+        .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd-hh-mm-ss"));
+    QString fileName = QDir(recordDirs.first()).filePath(recordBaseName + ".bag");
+
+    // the clock is installed and the subscriptions connected before the
+    // capture opens, the pre-roll ring holds messages stamped with wall
+    // time from before playback and is left out of the output
+    is_play_recording = true;
+    monitor.setClock([this](){ return engine.currentTime(); });
+    updateMonitor();
+    if(!monitor.waitForPublishers(PlayRecordConnectTimeout)) {
+        ROS_WARN("Some of the record topics have no publisher, their first messages may be missed");
+    }
+    if(!monitor.startCapture(fileName.toStdString(), false)) {
+        monitor.setClock(nullptr);
+        is_play_recording = false;
+        updateMonitor();
+        return;
+    }
 
-        if(is_loop_checked) {
-            arguments << "-l";
-        }
+    self->statusBar()->showMessage("Recording to " + fileName);
+    play();
+}
 
-        arguments << "--topics";
+void MainWindow::Impl::play()
+{
+    if(!filePaths.isEmpty()) {
+        std::vector<std::string> topics;
         for(int i = 0; i < playTree->topLevelItemCount(); ++i) {
             QTreeWidgetItem* item = playTree->topLevelItem(i);
             if(item->checkState(0) == Qt::Checked) {
-                arguments << item->text(0);
+                topics.push_back(item->text(0).toStdString());
             }
         }
 
-        playNode = QString("play_%1").arg(ros::Time::now().toNSec());
-
-        arguments << QString("__name:=%1").arg(playNode);
-        QProcess::startDetached("rosbag", arguments);
-        is_playing = true;
+        startDecoders();
+
+        engine.setTopics(topics);
+        engine.setRate(rate);
+        engine.setLoop(is_loop_checked);
+        engine.setPublishClock(is_clock_checked);
+        engine.setClockFrequency(clock_frequency);
+        engine.setClockOffset(clock_offset);
+        engine.setClockWallTime(is_clock_wall_time);
+        // a pause resumes after the last published message, only a position
+        // set by the user or a newly loaded bag is sought
+        if(is_position_changed) {
+            engine.seek(timeSpin->value());
+            is_position_changed = false;
+        }
+        is_playing = engine.play();
     } else {
         is_playing = false;
     }
@@ -324,11 +1047,19 @@ void MainWindow::Impl::play()
 void MainWindow::Impl::stop()
 {
     if(is_playing) {
-        QStringList arguments;
-        arguments << "kill" << QString("/%1").arg(playNode);
-        QProcess::startDetached("rosnode", arguments);
+        engine.pause();
+
+        // the decoders have nothing to flush, they are killed if they hang
+        decoders.interruptAll(1.0);
         is_playing = false;
     }
+
+    if(is_play_recording) {
+        monitor.stopCapture();
+        monitor.setClock(nullptr);
+        is_play_recording = false;
+        updateMonitor();
+    }
 }
 
 void MainWindow::Impl::config()
@@ -336,12 +1067,83 @@ void MainWindow::Impl::config()
     PlayerConfigDialog dialog(self);
     dialog.setLoopChecked(is_loop_checked);
     dialog.setClockChecked(is_clock_checked);
+    dialog.setClockFrequency(clock_frequency);
+    dialog.setClockOffset(clock_offset);
+    dialog.setClockWallTimeChecked(is_clock_wall_time);
     dialog.setRate(rate);
+    dialog.setComparePrefix(comparePrefix);
 
     if(dialog.exec()) {
         is_loop_checked = dialog.isLoopChecked();
         is_clock_checked = dialog.isClockChecked();
+        clock_frequency = dialog.clockFrequency();
+        clock_offset = dialog.clockOffset();
+        is_clock_wall_time = dialog.isClockWallTimeChecked();
         rate = dialog.rate();
+        if(!dialog.comparePrefix().isEmpty()) {
+            comparePrefix = dialog.comparePrefix();
+        }
+    }
+}
+
+void MainWindow::Impl::align()
+{
+    if(filePaths.size() < 2) {
+        self->statusBar()->showMessage("Open two or more bags to align them");
+        return;
+    }
+
+    if(is_playing) {
+        stop();
+    }
+
+    QStringList topics;
+    for(int i = 0; i < playTree->topLevelItemCount(); ++i) {
+        topics << playTree->topLevelItem(i)->text(0);
+    }
+
+    OffsetDialog dialog(filePaths, topics, self);
+    for(int i = 0; i < filePaths.size(); ++i) {
+        dialog.setOffset(i, engine.offset(i));
+    }
+    dialog.setEstimator([&](int index, const QString& topic){
+        return engine.estimateOffset(index, 0, topic.toStdString());
+    });
+
+    if(dialog.exec()) {
+        for(int i = 0; i < filePaths.size(); ++i) {
+            engine.setOffset(i, dialog.offset(i));
+        }
+        begin_time = engine.beginTime();
+        end_time = engine.endTime();
+        beginTimeSpin->setValue(0.0);
+        endTimeSpin->setValue((end_time - begin_time).toSec());
+    }
+}
+
+void MainWindow::Impl::recordConfig()
+{
+    RecorderConfigDialog dialog(self);
+    dialog.setDirectories(recordDirs);
+    dialog.setMinFreeSpace(min_free_space);
+    dialog.setSplitSize(split_size);
+    dialog.setQuantizationBits(quantization_bits);
+    dialog.setThreadCount(thread_count);
+    dialog.setPreroll(preroll);
+    dialog.setDiskFullAction(disk_full_action);
+
+    if(dialog.exec()) {
+        recordDirs = dialog.directories();
+        min_free_space = dialog.minFreeSpace();
+        split_size = dialog.splitSize();
+        quantization_bits = dialog.quantizationBits();
+        thread_count = dialog.threadCount();
+        preroll = dialog.preroll();
+        if(is_armed) {
+            monitor.setPreroll(preroll);
+        }
+        disk_full_action = dialog.diskFullAction();
+        updateMonitor();
     }
 }
 
@@ -363,61 +1165,623 @@ void MainWindow::Impl::checkPlay(const bool& checked)
 
 void MainWindow::Impl::loadFile(const QString& fileName)
 {
-    filePath = fileName;
+    scanner->cancel();
+    filePaths.clear();
+    is_comparing = false;
+    is_restoring = false;
+
+    // a .bagset or a part of a split recording opens the whole set
+    for(auto& file : BagPlayerEngine::expandFiles(fileName.toStdString())) {
+        filePaths << QString::fromStdString(file);
+    }
+
+    if(!openBags()) {
+        self->statusBar()->showMessage("Failed to open " + fileName);
+    }
+}
 
-    while(playTree->topLevelItemCount() > 0) {
-        playTree->takeTopLevelItem(0);
+bool MainWindow::Impl::openBags()
+{
+    playTree->clear();
+
+    if(!engine.load(toStdVector(filePaths))) {
+        filePaths.clear();
+        return false;
     }
+    is_position_changed = true;
 
-    rosbag::Bag bag(fileName.toStdString().c_str());
-    rosbag::View view(bag);
+    // the second bag of a comparison is played under the prefix
+    if(is_comparing) {
+        engine.setPrefix(1, comparePrefix.toStdString());
+    }
 
-    begin_time = view.getBeginTime();
-    end_time = view.getEndTime();
+    begin_time = engine.beginTime();
+    end_time = engine.endTime();
     double duration = (end_time - begin_time).toSec();
     beginTimeSpin->setValue(0.0);
     endTimeSpin->setValue(duration);
 
-    std::vector<const rosbag::ConnectionInfo*> connections = view.getConnections();
-    for(auto& info : connections) {
-        QString topicName = info->topic.c_str();
+    for(auto& topic : engine.topics()) {
         QTreeWidgetItem* item = new QTreeWidgetItem(playTree);
-        item->setText(0, topicName);
+        item->setText(0, topic.first.c_str());
+        item->setText(1, topic.second.c_str());
         item->setCheckState(0, Qt::Checked);
     }
+    cacheBags();
+    return true;
 }
 
-void MainWindow::Impl::saveFile(const QString& fileName)
+bool MainWindow::Impl::restoreBags(const QStringList& fileNames, const QString& databaseName)
 {
-    int count = playTree->topLevelItemCount();
-    if(count > 0) {
-        QStringList arguments;
-        arguments << "filter" << filePath << fileName;
-        QString option = "topic == ";
-        for(int i = 0; i < count; ++i) {
-            QTreeWidgetItem* item = playTree->topLevelItem(i);
-            if(item->checkState(0) == Qt::Checked) {
-                option += QString("'%1' or ").arg(item->text(0));
+    // the tree and the timeline are filled from the index cache at once,
+    // the bags are opened in the background as for a folder
+    std::vector<CachedBag> bags;
+    for(auto& fileName : fileNames) {
+        CachedBag bag;
+        if(!BagLibrary::cachedBag(fileName, bag, databaseName)) {
+            return false;
+        }
+        bags.push_back(bag);
+    }
+
+    engine.close();
+    playTree->clear();
+    begin_time = ros::Time();
+    end_time = ros::Time();
+    for(size_t i = 0; i < bags.size(); ++i) {
+        double offset = (int)i < restoredOffsets.size() ? restoredOffsets[i] : 0.0;
+        ros::Time begin(std::max(0.0, bags[i].begin_time + offset));
+        ros::Time end(std::max(0.0, bags[i].end_time + offset));
+        if(i == 0 || begin < begin_time) {
+            begin_time = begin;
+        }
+        if(i == 0 || end > end_time) {
+            end_time = end;
+        }
+
+        QString prefix = is_comparing && i == 1 ? comparePrefix : QString();
+        for(auto& topic : bags[i].topics) {
+            QString name = prefix + topic.first;
+            if(playTree->findItems(name, Qt::MatchExactly, 0).isEmpty()) {
+                QTreeWidgetItem* item = new QTreeWidgetItem(playTree);
+                item->setText(0, name);
+                item->setText(1, topic.second);
+                item->setCheckState(0, Qt::Checked);
             }
         }
-        option.chop(4);
-        arguments << option;
-        QProcess::startDetached("rosbag", arguments);
     }
+    beginTimeSpin->setValue(0.0);
+    endTimeSpin->setValue((end_time - begin_time).toSec());
+
+    is_restoring = true;
+    scanPaths = fileNames;
+    scanner->scan(fileNames);
+    self->statusBar()->showMessage(QString("Opening %1 bags from the index cache").arg(fileNames.size()));
+    return true;
+}
+
+void MainWindow::Impl::applyRestoredOffsets()
+{
+    for(int i = 0; i < restoredOffsets.size() && i < filePaths.size(); ++i) {
+        engine.setOffset(i, restoredOffsets[i]);
+    }
+    restoredOffsets.clear();
+
+    begin_time = engine.beginTime();
+    end_time = engine.endTime();
+    beginTimeSpin->setValue(0.0);
+    endTimeSpin->setValue((end_time - begin_time).toSec());
+}
+
+void MainWindow::Impl::cacheBags()
+{
+    for(auto& fileName : filePaths) {
+        bagIndexer()->enqueue(fileName);
+    }
+}
+
+QVariantMap MainWindow::Impl::saveSettings() const
+{
+    // numbers in lists are kept as strings, perspectives store them as text
+    QVariantMap settings;
+    settings["files"] = is_restoring ? scanPaths : filePaths;
+    settings["comparing"] = is_comparing;
+    settings["compare_prefix"] = comparePrefix;
+    QStringList offsets;
+    for(int i = 0; i < filePaths.size(); ++i) {
+        offsets << QString::number(engine.offset(i), 'g', 12);
+    }
+    settings["offsets"] = offsets;
+    settings["position"] = timeSpin->value();
+    settings["play_unchecked"] = uncheckedTopics(playTree);
+
+    // the bags are looked up in this index when the perspective is restored
+    settings["index"] = BagLibrary::defaultDatabaseName();
+
+    settings["rate"] = rate;
+    settings["loop"] = is_loop_checked;
+    settings["clock"] = is_clock_checked;
+    settings["clock_frequency"] = clock_frequency;
+    settings["clock_offset"] = clock_offset;
+    settings["clock_wall_time"] = is_clock_wall_time;
+
+    QStringList options;
+    for(auto it = recordOptions.begin(); it != recordOptions.end(); ++it) {
+        options << (QStringList() << it.key() << it.value().encoding << it.value().compression << it.value().transport).join(";");
+    }
+    settings["record_options"] = options;
+    settings["record_unchecked"] = uncheckedTopics(recordTree) + restoredRecordUnchecked;
+    settings["record_dirs"] = recordDirs;
+    settings["min_free_space"] = min_free_space;
+    settings["split_size"] = split_size;
+    settings["disk_full_action"] = disk_full_action;
+    settings["quantization_bits"] = quantization_bits;
+    settings["thread_count"] = thread_count;
+    settings["preroll"] = preroll;
+    return settings;
+}
+
+void MainWindow::Impl::restoreSettings(const QVariantMap& settings)
+{
+    rate = settings.value("rate", rate).toDouble();
+    is_loop_checked = settings.value("loop", is_loop_checked).toBool();
+    is_clock_checked = settings.value("clock", is_clock_checked).toBool();
+    clock_frequency = settings.value("clock_frequency", clock_frequency).toDouble();
+    clock_offset = settings.value("clock_offset", clock_offset).toDouble();
+    is_clock_wall_time = settings.value("clock_wall_time", is_clock_wall_time).toBool();
+    if(!settings.value("compare_prefix").toString().isEmpty()) {
+        comparePrefix = settings.value("compare_prefix").toString();
+    }
+
+    for(auto& option : toStringList(settings.value("record_options"))) {
+        QStringList parts = option.split(";");
+        if(parts.size() == 4) {
+            RecordOption recordOption;
+            recordOption.encoding = parts[1];
+            // perspectives saved with the former "delta" recorded it as bz2
+            recordOption.compression = parts[2] == "delta" ? "bz2" : parts[2];
+            recordOption.transport = parts[3];
+            recordOptions[parts[0]] = recordOption;
+        }
+    }
+    if(settings.contains("record_dirs")) {
+        recordDirs = toStringList(settings.value("record_dirs"));
+    }
+    min_free_space = settings.value("min_free_space", min_free_space).toInt();
+    split_size = settings.value("split_size", split_size).toInt();
+    disk_full_action = settings.value("disk_full_action", disk_full_action).toInt();
+    quantization_bits = settings.value("quantization_bits", quantization_bits).toInt();
+    thread_count = settings.value("thread_count", thread_count).toInt();
+    preroll = settings.value("preroll", preroll).toDouble();
+
+    // record topics appear with the master's topic list, possibly later
+    restoredRecordUnchecked = toStringList(settings.value("record_unchecked"));
+    for(int i = 0; i < recordTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* item = recordTree->topLevelItem(i);
+        RecordOption option = recordOptions.value(item->text(0));
+        setEncoding(item, option.encoding);
+        setCompression(item, option.compression);
+        setTransport(item, option.transport);
+        if(restoredRecordUnchecked.contains(item->text(0))) {
+            item->setCheckState(0, Qt::Unchecked);
+        }
+    }
+    updateMonitor();
+
+    QStringList files = toStringList(settings.value("files"));
+    if(files.isEmpty()) {
+        return;
+    }
+    if(is_playing) {
+        stop();
+    }
+
+    scanner->cancel();
+    filePaths.clear();
+    is_comparing = settings.value("comparing").toBool() && files.size() == 2;
+    restoredOffsets.clear();
+    for(auto& offset : toStringList(settings.value("offsets"))) {
+        restoredOffsets << offset.toDouble();
+    }
+
+    // bags missing from the saved index, or changed since, are opened right away
+    QString index = settings.value("index").toString();
+    if(index.isEmpty()) {
+        index = BagLibrary::defaultDatabaseName();
+    }
+    if(!restoreBags(files, index)) {
+        filePaths = files;
+        if(!openBags()) {
+            self->statusBar()->showMessage("Failed to open " + files.join(", "));
+            return;
+        }
+        applyRestoredOffsets();
+    }
+
+    QStringList unchecked = toStringList(settings.value("play_unchecked"));
+    for(int i = 0; i < playTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* item = playTree->topLevelItem(i);
+        if(unchecked.contains(item->text(0))) {
+            item->setCheckState(0, Qt::Unchecked);
+        }
+    }
+    timeSpin->setValue(qBound(0.0, settings.value("position").toDouble(), endTimeSpin->value()));
+}
+
+void MainWindow::Impl::loadFolder(const QString& dir)
+{
+    // the bags are handed to the player once all of them are scanned,
+    // until then the tree and the timeline grow with every scanned bag
+    engine.close();
+    filePaths.clear();
+    is_comparing = false;
+    is_restoring = false;
+    playTree->clear();
+    begin_time = ros::Time();
+    end_time = ros::Time();
+    beginTimeSpin->setValue(0.0);
+    endTimeSpin->setValue(0.0);
+
+    QStringList fileNames;
+    for(auto& name : QDir(dir).entryList(QStringList() << "*.bag", QDir::Files, QDir::Name)) {
+        fileNames << QDir(dir).filePath(name);
+    }
+    scanPaths = fileNames;
+    scanner->scan(fileNames);
+
+    self->statusBar()->showMessage(QString("Scanning %1 bags in %2").arg(fileNames.size()).arg(dir));
+}
+
+void MainWindow::Impl::saveFile(const QString& fileName)
+{
+    is_exporting = engine.exportBag(fileName.toStdString(), toStdVector(checkedPlayTopics()), false);
+    if(!is_exporting) {
+        self->statusBar()->showMessage("Failed to export " + fileName);
+    }
+}
+
+QStringList MainWindow::Impl::checkedPlayTopics() const
+{
+    QStringList topics;
+    for(int i = 0; i < playTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* item = playTree->topLevelItem(i);
+        if(item->checkState(0) == Qt::Checked) {
+            topics << item->text(0);
+        }
+    }
+    return topics;
+}
+
+void MainWindow::Impl::startServices()
+{
+    // the services run on their own thread and hand each request to the
+    // GUI thread, waiting until it has been carried out
+    ServiceServer::Handlers handlers;
+    handlers.load = [&](const std::vector<std::string>& files, std::string& message){
+        return invoke([&](std::string& message){
+            if(files.empty()) {
+                message = "No file given";
+                return false;
+            }
+            if(is_playing) {
+                stop();
+            }
+            if(files.size() == 1) {
+                loadFile(QString::fromStdString(files[0]));
+            } else {
+                scanner->cancel();
+                filePaths.clear();
+                for(auto& file : files) {
+                    filePaths << QString::fromStdString(file);
+                }
+                is_comparing = false;
+                is_restoring = false;
+                openBags();
+            }
+            if(filePaths.isEmpty()) {
+                message = "Failed to open the bags";
+                return false;
+            }
+            return true;
+        }, message);
+    };
+    handlers.play = [&](const bool& on, std::string& message){
+        return invoke([&](std::string& message){
+            if(!on) {
+                if(is_playing) {
+                    showPosition(position());
+                    stop();
+                }
+                return true;
+            }
+            if(filePaths.isEmpty()) {
+                message = "No bag is open";
+                return false;
+            }
+            if(!is_playing) {
+                play();
+            }
+            return is_playing;
+        }, message);
+    };
+    handlers.seek = [&](const double& time, std::string& message){
+        return invoke([&](std::string& message){
+            if(time < 0.0 || time > (end_time - begin_time).toSec()) {
+                message = "Time is out of the bag";
+                return false;
+            }
+            bool was_playing = is_playing;
+            if(was_playing) {
+                stop();
+            }
+            timeSpin->setValue(time);
+            if(was_playing) {
+                play();
+            }
+            return true;
+        }, message);
+    };
+    handlers.setRate = [&](const double& value, std::string& message){
+        return invoke([&](std::string& message){
+            if(value <= 0.0) {
+                message = "Rate must be positive";
+                return false;
+            }
+            rate = value;
+            if(is_playing) {
+                showPosition(position());
+                stop();
+                play();
+            }
+            return true;
+        }, message);
+    };
+    handlers.step = [&](const size_t& count, std::string& message){
+        return invoke([&](std::string& message){
+            if(filePaths.isEmpty()) {
+                message = "No bag is open";
+                return false;
+            }
+            if(is_playing) {
+                stop();
+            }
+            engine.step(count);
+            showPosition(position());
+            return true;
+        }, message);
+    };
+    handlers.record = [&](const bool& start, std::string& message){
+        // the recorder and its bags belong to the GUI thread, only a copy
+        // of the bag names is waited for here
+        QStringList bags;
+        bool result = invoke([&](std::string& message){
+            recordAct->setChecked(start);
+            if(is_recording != start) {
+                message = "Failed to start recording";
+                return false;
+            }
+            bags = recordBags;
+            return true;
+        }, message);
+
+        // rosbag record runs in its own process, wait for its bags
+        if(result && !Recorder::waitForBags(bags, start, 10.0)) {
+            message = start ? "Recorder did not start" : "Recorder did not close its bags";
+            return false;
+        }
+        return result;
+    };
+    handlers.exportBag = [&](const std::string& file, const std::vector<std::string>& topics, std::string& message){
+        std::vector<std::string> names = topics;
+        if(names.empty()) {
+            invoke([&](std::string&){
+                names = toStdVector(checkedPlayTopics());
+                return true;
+            }, message);
+        }
+
+        // rosbag filter is waited for here, the GUI stays responsive
+        if(!engine.exportBag(file, names)) {
+            message = "Nothing to export or rosbag filter failed";
+            return false;
+        }
+        return true;
+    };
+    if(!services.start(serviceNamespace.toStdString(), handlers)) {
+        ROS_ERROR("The services of %s are already advertised, this window has no control services",
+            serviceNamespace.toStdString().c_str());
+        self->statusBar()->showMessage("Services " + serviceNamespace + " are already in use");
+    }
+}
+
+bool MainWindow::Impl::invoke(const std::function<bool(std::string&)>& function, std::string& message)
+{
+    // a blocking queued call would deadlock shutdown, which joins the
+    // service thread on the GUI thread, so the wait gives up once shut down
+    struct Call
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool is_done = false;
+        bool result = false;
+    };
+    auto call = std::make_shared<Call>();
+
+    QMetaObject::invokeMethod(self, [this, call, &function, &message](){
+        // the request has given up already, its arguments are gone
+        if(is_shut_down) {
+            return;
+        }
+        bool result = function(message);
+        {
+            std::lock_guard<std::mutex> lock(call->mutex);
+            call->result = result;
+            call->is_done = true;
+        }
+        call->condition.notify_all();
+    }, Qt::QueuedConnection);
+
+    std::unique_lock<std::mutex> lock(call->mutex);
+    while(!call->is_done) {
+        if(is_shut_down) {
+            message = "Bag player is shutting down";
+            return false;
+        }
+        call->condition.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    return call->result;
+}
+
+void MainWindow::Impl::startDeferred()
+{
+    if(is_started || is_shut_down) {
+        return;
+    }
+    is_started = true;
+
+    timer->start();
+    startServices();
+    on_masterTimer_timeout();
+    masterTimer->start();
+    ROS_DEBUG("Bag player started in %lld ms", (long long)startupTimer.elapsed());
+}
+
+void MainWindow::Impl::createLibrary()
+{
+    if(library) {
+        return;
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    library = new BagLibrary;
+    self->connect(library, &BagLibrary::bagActivated, [&](const QString& fileName){
+        if(is_playing) {
+            stop();
+        }
+        loadFile(fileName);
+    });
+    libraryDock->setWidget(library);
+    ROS_DEBUG("Bag library created in %lld ms", (long long)elapsed.elapsed());
+}
+
+BagIndexer* MainWindow::Impl::bagIndexer()
+{
+    // opened bags are added to the library's index, so a restored
+    // perspective shows them before they are opened again
+    if(!indexer) {
+        indexer = new BagIndexer(BagLibrary::defaultDatabaseName(), self);
+        indexer->start(QThread::LowPriority);
+    }
+    return indexer;
+}
+
+void MainWindow::Impl::shutdown()
+{
+    if(is_shut_down) {
+        return;
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    is_shut_down = true;
+    timer->stop();
+    masterTimer->stop();
+
+    // a service request may be waiting for an export, so exports go first
+    engine.cancelExport();
+    services.stop();
+
+    scanner->cancel();
+    if(is_playing) {
+        stop();
+    }
+    decoders.stopAll(1.0);
+
+    // rosbag record writes its index on SIGINT, the wait lets it finish
+    monitor.stopCapture();
+    for(auto& watchdog : watchdogs) {
+        watchdog->stop();
+        watchdog->deleteLater();
+    }
+    watchdogs.clear();
+    if(!engine.stopRecord(RecordStopTimeout)) {
+        ROS_WARN("A recorder had to be killed, its bag may be left as .bag.active");
+    }
+    is_recording = false;
+    is_handing_over = false;
+    if(is_trim_pending) {
+        trimPreroll();
+    }
+
+    monitor.shutdown();
+    engine.close();
+    if(indexer) {
+        indexer->stop();
+    }
+    ROS_DEBUG("Bag player shut down in %lld ms", (long long)elapsed.elapsed());
+}
+
+double MainWindow::Impl::position() const
+{
+    return engine.position();
+}
+
+void MainWindow::Impl::showPosition(const double& value)
+{
+    is_showing_position = true;
+    timeSpin->setValue(value);
+    is_showing_position = false;
 }
 
 void MainWindow::Impl::on_timer_timeout()
 {
-    static int numTopics = 0;
+    if(is_playing) {
+        showPosition(position());
+    }
+
+    // the player has reached the end of the bag
+    if(is_playing && !engine.isPlaying()) {
+        stop();
+    }
+
+    // rosbag filter reports its progress on its output
+    if(is_exporting) {
+        double progress = engine.exportProgress();
+        if(progress < 0.0) {
+            is_exporting = false;
+            self->statusBar()->showMessage("Export finished");
+        } else {
+            self->statusBar()->showMessage(QString("Exporting %1%").arg(progress, 0, 'f', 0));
+        }
+    }
+
+    if(is_handing_over || is_trim_pending) {
+        updateHandover();
+    }
 
+    // show which part of a split recording is being played
+    if(is_playing && filePaths.size() > 1) {
+        QString fileName = QString::fromStdString(engine.currentFileName());
+        if(fileName != playingFile) {
+            playingFile = fileName;
+            self->statusBar()->showMessage("Playing " + QFileInfo(fileName).fileName());
+        }
+    }
+}
+
+void MainWindow::Impl::on_masterTimer_timeout()
+{
     ros::master::V_TopicInfo topics;
     if(ros::master::getTopics(topics)) {
-        if(topics.size() != numTopics) {
-            numTopics = topics.size();
+        if(topics.size() != num_topics) {
+            num_topics = topics.size();
 
-            while(recordTree->topLevelItemCount() > 0) {
-                recordTree->takeTopLevelItem(0);
-            }
+            // keep the user's selection across refreshes
+            QStringList uncheckedNames = uncheckedTopics(recordTree) + restoredRecordUnchecked;
+            restoredRecordUnchecked.clear();
+            recordTree->blockSignals(true);
+            recordTree->clear();
 
             for(size_t i = 0; i < topics.size(); ++i) {
                 ros::master::TopicInfo info = topics[i];
@@ -425,14 +1789,98 @@ void MainWindow::Impl::on_timer_timeout()
                 QString dataType = info.datatype.c_str();
                 QTreeWidgetItem* item = new QTreeWidgetItem(recordTree);
                 item->setText(0, name);
-                item->setCheckState(0, Qt::Checked);
+                item->setText(1, dataType);
+                item->setCheckState(0, uncheckedNames.contains(name) ? Qt::Unchecked : Qt::Checked);
+                setEncoding(item, recordOptions.value(name).encoding);
+                setCompression(item, recordOptions.value(name).compression);
+                setTransport(item, recordOptions.value(name).transport);
             }
+            recordTree->blockSignals(false);
+            updateMonitor();
+        }
+    }
+}
+
+void MainWindow::Impl::on_scanner_scanned(const QString& fileName, const int& done, const int& total)
+{
+    BagScanner::Result result = scanner->result(fileName);
+    self->statusBar()->showMessage(QString("Scanned %1 of %2 bags").arg(done).arg(total));
+    if(!result.bag || is_restoring) {
+        return;
+    }
+
+    if(begin_time.isZero() || result.begin_time < begin_time) {
+        begin_time = result.begin_time;
+    }
+    if(end_time.isZero() || result.end_time > end_time) {
+        end_time = result.end_time;
+    }
+    beginTimeSpin->setValue(0.0);
+    endTimeSpin->setValue((end_time - begin_time).toSec());
+
+    for(auto& topic : result.topics) {
+        QString name = topic.first.c_str();
+        if(playTree->findItems(name, Qt::MatchExactly, 0).isEmpty()) {
+            QTreeWidgetItem* item = new QTreeWidgetItem(playTree);
+            item->setText(0, name);
+            item->setText(1, topic.second.c_str());
+            item->setCheckState(0, Qt::Checked);
         }
     }
 }
 
+void MainWindow::Impl::on_scanner_finished()
+{
+    std::vector<std::shared_ptr<rosbag::Bag>> bags;
+    for(auto& fileName : scanPaths) {
+        BagScanner::Result result = scanner->result(fileName);
+        if(result.bag) {
+            bags.push_back(result.bag);
+            filePaths << fileName;
+        }
+    }
+
+    if(!engine.load(bags)) {
+        self->statusBar()->showMessage("No bag could be opened");
+        filePaths.clear();
+        is_restoring = false;
+        return;
+    }
+    is_position_changed = true;
+    cacheBags();
+
+    // a restored comparison or alignment is applied once the bags are open
+    if(is_restoring) {
+        if(is_comparing) {
+            engine.setPrefix(1, comparePrefix.toStdString());
+        }
+        applyRestoredOffsets();
+        is_restoring = false;
+    }
+
+    begin_time = engine.beginTime();
+    end_time = engine.endTime();
+    self->statusBar()->showMessage(QString("Opened %1 bags").arg(filePaths.size()));
+}
+
+void MainWindow::Impl::on_watchdog_thresholdCrossed(DiskWatchdog* watchdog)
+{
+    if(disk_full_action == RecorderConfigDialog::Rotate && watchdog->removeOldestFile()) {
+        self->statusBar()->showMessage("Disk almost full, removed the oldest split");
+        return;
+    }
+
+    // rosbag record closes the bag and writes its index when the node is shut down
+    recordAct->setChecked(false);
+    self->statusBar()->showMessage("Disk almost full, recording stopped");
+}
+
 void MainWindow::Impl::on_timeSpin_valueChanged(double value)
 {
+    if(!is_showing_position) {
+        is_position_changed = true;
+    }
+
     int min = timeSlider->minimum();
     int max = timeSlider->maximum();
     double duration = endTimeSpin->value() - beginTimeSpin->value();
@@ -449,6 +1897,7 @@ void MainWindow::Impl::on_timeSlider_valueChanged(int value)
     int max = timeSlider->maximum();
     double rate = (double)value / (double)(max - min);
     double duration = endTimeSpin->value() - beginTimeSpin->value();
+    is_position_changed = true;
 
     timeSpin->blockSignals(true);
     timeSpin->setValue(duration * rate);
@@ -469,17 +1918,89 @@ void MainWindow::Impl::on_recordTree_customContextMenuRequested(const QPoint& po
     QMenu menu(self);
     menu.addAction(checkRecordAct);
     menu.addAction(uncheckRecordAct);
+
+    QStringList encodings;
+    QTreeWidgetItem* item = recordTree->itemAt(pos);
+    if(item && item->text(1) == "sensor_msgs/Image") {
+        encodings << "" << "png" << "jpeg";
+    } else if(item && item->text(1) == "sensor_msgs/PointCloud2") {
+        encodings << "" << "draco";
+    }
+
+    // the master's topic list may rebuild the tree while the menu is open,
+    // the actions look their topic up again
+    QString topic = item ? item->text(0) : QString();
+    auto apply = [=](const std::function<void(QTreeWidgetItem*)>& function){
+        return [=](){
+            QTreeWidgetItem* current = findRecordItem(topic);
+            if(current) {
+                function(current);
+            }
+        };
+    };
+
+    if(!encodings.isEmpty()) {
+        menu.addSeparator();
+        QMenu* encodingMenu = menu.addMenu("&Encoding");
+        for(auto& encoding : encodings) {
+            QAction* action = encodingMenu->addAction(encoding.isEmpty() ? "raw" : encoding);
+            action->setCheckable(true);
+            action->setChecked(recordOptions.value(topic).encoding == encoding);
+            self->connect(action, &QAction::triggered, apply([=](QTreeWidgetItem* item){ setEncoding(item, encoding); }));
+        }
+    }
+
+    if(item) {
+        menu.addSeparator();
+        QMenu* compressionMenu = menu.addMenu("C&ompression");
+        for(auto& compression : QStringList() << "" << "lz4" << "bz2" << "auto") {
+            QAction* action = compressionMenu->addAction(compression.isEmpty() ? "none" : compression);
+            action->setCheckable(true);
+            action->setChecked(recordOptions.value(topic).compression == compression);
+            self->connect(action, &QAction::triggered, apply([=](QTreeWidgetItem* item){ setCompression(item, compression); }));
+        }
+
+        QMenu* transportMenu = menu.addMenu("&Transport");
+        for(auto& transport : QStringList() << "" << "tcpnodelay" << "udp") {
+            QAction* action = transportMenu->addAction(transport.isEmpty() ? "tcp" : transport);
+            action->setCheckable(true);
+            action->setChecked(recordOptions.value(topic).transport == transport);
+            self->connect(action, &QAction::triggered, apply([=](QTreeWidgetItem* item){ setTransport(item, transport); }));
+        }
+    }
+
     menu.exec(recordTree->mapToGlobal(pos));
 }
 
 void MainWindow::Impl::createActions()
 {
+    libraryAct = libraryDock->toggleViewAction();
+    libraryAct->setIcon(QIcon::fromTheme("folder"));
+    libraryAct->setStatusTip("Show the bag library");
+    self->connect(libraryAct, &QAction::toggled, [&](bool checked){
+        if(!checked) {
+            return;
+        }
+        createLibrary();
+        if(library->rootDirectory().isEmpty()) {
+            library->setRootDirectory(recordDirs.isEmpty() ? QDir::homePath() : recordDirs.first());
+        }
+    });
+
     const QIcon openIcon = QIcon::fromTheme("document-open");
     openAct = new QAction(openIcon, "&Open...", self);
     openAct->setShortcuts(QKeySequence::Open);
     openAct->setStatusTip("Open an existing file");
     self->connect(openAct, &QAction::triggered, [&](){ open(); });
 
+    openFolderAct = new QAction(openIcon, "Open &Folder...", self);
+    openFolderAct->setStatusTip("Open all bags in a folder");
+    self->connect(openFolderAct, &QAction::triggered, [&](){ openFolder(); });
+
+    compareAct = new QAction(QIcon::fromTheme("view-dual"), "Co&mpare...", self);
+    compareAct->setStatusTip("Play two bags in lockstep, the second under the compare prefix");
+    self->connect(compareAct, &QAction::triggered, [&](){ compare(); });
+
     const QIcon saveIcon = QIcon::fromTheme("document-save");
     saveAct = new QAction(saveIcon, "&Save", self);
     saveAct->setShortcuts(QKeySequence::Save);
@@ -492,6 +2013,12 @@ void MainWindow::Impl::createActions()
     recordAct->setCheckable(true);
     self->connect(recordAct, &QAction::toggled, [&](bool checked){ record(checked); });
 
+    const QIcon armIcon = QIcon::fromTheme("media-record");
+    armAct = new QAction(armIcon, "&Arm", self);
+    armAct->setStatusTip("Keep the record topics subscribed so recording starts instantly");
+    armAct->setCheckable(true);
+    self->connect(armAct, &QAction::toggled, [&](bool checked){ arm(checked); });
+
     const QIcon playIcon = QIcon::fromTheme("media-playback-start");
     playAct = new QAction(playIcon, "&Play", self);
     playAct->setStatusTip("Play topics");
@@ -507,11 +2034,26 @@ void MainWindow::Impl::createActions()
     stopAct->setStatusTip("Stop topics");
     self->connect(stopAct, &QAction::triggered, [&](){ clickStop(); });
 
+    const QIcon playRecordIcon = QIcon::fromTheme("media-seek-forward");
+    playRecordAct = new QAction(playRecordIcon, "Play && Re&cord", self);
+    playRecordAct->setStatusTip("Play the bag and record the checked record topics on its clock");
+    self->connect(playRecordAct, &QAction::triggered, [&](){ clickPlayRecord(); });
+
     const QIcon configIcon = QIcon::fromTheme("preferences-system");
     configAct = new QAction(configIcon, "&Config", self);
     configAct->setStatusTip("Show the config dialog");
     self->connect(configAct, &QAction::triggered, [&](){ config(); });
 
+    const QIcon alignIcon = QIcon::fromTheme("view-refresh");
+    alignAct = new QAction(alignIcon, "A&lign", self);
+    alignAct->setStatusTip("Set the clock offsets between the opened bags");
+    self->connect(alignAct, &QAction::triggered, [&](){ align(); });
+
+    const QIcon recordConfigIcon = QIcon::fromTheme("document-properties");
+    recordConfigAct = new QAction(recordConfigIcon, "&Record Config", self);
+    recordConfigAct->setStatusTip("Show the record config dialog");
+    self->connect(recordConfigAct, &QAction::triggered, [&](){ recordConfig(); });
+
     checkPlayAct = new QAction("&Check All", self);
     checkPlayAct->setStatusTip("Check all play topics");
     self->connect(checkPlayAct, &QAction::triggered, [&](){ checkPlay(true); });
@@ -532,14 +2074,21 @@ void MainWindow::Impl::createActions()
 void MainWindow::Impl::createToolBars()
 {
     QToolBar* playerToolBar = self->addToolBar("Bag Player");
+    playerToolBar->addAction(libraryAct);
     playerToolBar->addAction(openAct);
+    playerToolBar->addAction(openFolderAct);
+    playerToolBar->addAction(compareAct);
     playerToolBar->addAction(saveAct);
     playerToolBar->addSeparator();
+    playerToolBar->addAction(armAct);
     playerToolBar->addAction(recordAct);
     playerToolBar->addAction(playAct);
     playerToolBar->addAction(resumeAct);
     playerToolBar->addAction(stopAct);
+    playerToolBar->addAction(playRecordAct);
     playerToolBar->addAction(configAct);
+    playerToolBar->addAction(alignAct);
+    playerToolBar->addAction(recordConfigAct);
 
     beginTimeSpin = new QDoubleSpinBox;
     beginTimeSpin->setRange(0.0, 9999.0);
@@ -565,13 +2114,6 @@ void MainWindow::Impl::createToolBars()
     playerToolBar->addWidget(endTimeSpin);
 }
 
-void MainWindow::Impl::clockCallback(const rosgraph_msgs::ClockPtr& msg)
-{
-    ros::Time clock = msg->clock;
-    double time = (clock - begin_time).toSec();
-    timeSpin->setValue(time);
-}
-
 PlayerConfigDialog::PlayerConfigDialog(QWidget* parent)
     : QDialog(parent)
 {
@@ -583,11 +2125,37 @@ PlayerConfigDialog::PlayerConfigDialog(QWidget* parent)
 
     rateSpin = new QDoubleSpinBox;
 
+    clockFrequencySpin = new QDoubleSpinBox;
+    clockFrequencySpin->setRange(0.0, 10000.0);
+    clockFrequencySpin->setSuffix(" Hz");
+    clockFrequencySpin->setSpecialValueText("Per message");
+    clockFrequencySpin->setToolTip("Publish /clock at a fixed rate of wall time, whatever the message density");
+
+    clockOffsetSpin = new QDoubleSpinBox;
+    clockOffsetSpin->setRange(-86400.0, 86400.0);
+    clockOffsetSpin->setDecimals(3);
+    clockOffsetSpin->setSuffix(" s");
+    clockOffsetSpin->setToolTip("Added to the published /clock, the messages are not changed");
+
+    wallTimeCheck = new QCheckBox;
+    wallTimeCheck->setText("Wall time");
+    wallTimeCheck->setToolTip("Start /clock at the current wall time instead of the bag time");
+
+    prefixLine = new QLineEdit;
+    prefixLine->setToolTip("Namespace the topics of the second bag are played under when comparing");
+
     auto gridLayout = new QGridLayout;
     gridLayout->addWidget(new QLabel("Rate"), 0, 0);
     gridLayout->addWidget(rateSpin, 0, 1);
     gridLayout->addWidget(loopCheck, 1, 0);
     gridLayout->addWidget(clockCheck, 1, 1);
+    gridLayout->addWidget(new QLabel("Clock frequency"), 2, 0);
+    gridLayout->addWidget(clockFrequencySpin, 2, 1);
+    gridLayout->addWidget(new QLabel("Clock offset"), 3, 0);
+    gridLayout->addWidget(clockOffsetSpin, 3, 1);
+    gridLayout->addWidget(wallTimeCheck, 4, 1);
+    gridLayout->addWidget(new QLabel("Compare prefix"), 5, 0);
+    gridLayout->addWidget(prefixLine, 5, 1);
 
     buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok
                                      | QDialogButtonBox::Cancel);
@@ -604,4 +2172,134 @@ PlayerConfigDialog::PlayerConfigDialog(QWidget* parent)
     setWindowTitle("Player Config");
 }
 
+OffsetDialog::OffsetDialog(const QStringList& fileNames, const QStringList& topics, QWidget* parent)
+    : QDialog(parent)
+{
+    auto gridLayout = new QGridLayout;
+    for(int i = 0; i < fileNames.size(); ++i) {
+        auto offsetSpin = new QDoubleSpinBox;
+        offsetSpin->setRange(-86400.0, 86400.0);
+        offsetSpin->setDecimals(3);
+        offsetSpin->setSuffix(" s");
+        offsetSpin->setEnabled(i > 0);
+        offsetSpins << offsetSpin;
+
+        gridLayout->addWidget(new QLabel(QFileInfo(fileNames[i]).fileName()), i, 0);
+        gridLayout->addWidget(offsetSpin, i, 1);
+    }
+
+    topicCombo = new QComboBox;
+    topicCombo->addItems(topics);
+    topicCombo->setToolTip("A topic recorded in every bag, irregular ones align best");
+
+    auto estimateButton = new QPushButton("Estimate");
+    connect(estimateButton, &QPushButton::clicked, [&](){ estimate(); });
+
+    int row = fileNames.size();
+    gridLayout->addWidget(topicCombo, row, 0);
+    gridLayout->addWidget(estimateButton, row, 1);
+
+    buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok
+                                     | QDialogButtonBox::Cancel);
+
+    connect(buttonBox, &QDialogButtonBox::accepted, [&](){ accept(); });
+    connect(buttonBox, &QDialogButtonBox::rejected, [&](){ reject(); });
+
+    auto mainLayout = new QVBoxLayout;
+    mainLayout->addLayout(gridLayout);
+    mainLayout->addWidget(buttonBox);
+    mainLayout->addStretch();
+
+    setLayout(mainLayout);
+    setWindowTitle("Bag Offsets");
+}
+
+void OffsetDialog::estimate()
+{
+    if(!estimator || topicCombo->currentText().isEmpty()) {
+        return;
+    }
+
+    for(int i = 1; i < offsetSpins.size(); ++i) {
+        offsetSpins[i]->setValue(estimator(i, topicCombo->currentText()));
+    }
+}
+
+RecorderConfigDialog::RecorderConfigDialog(QWidget* parent)
+    : QDialog(parent)
+{
+    dirLine = new QLineEdit;
+    dirLine->setToolTip("Separate directories on different disks with ';' to stripe the recording");
+
+    auto browseButton = new QPushButton("Browse...");
+    connect(browseButton, &QPushButton::clicked, [&](){ browse(); });
+
+    freeSpin = new QSpinBox;
+    freeSpin->setRange(0, 1024 * 1024);
+    freeSpin->setSuffix(" MB");
+
+    splitSpin = new QSpinBox;
+    splitSpin->setRange(0, 1024 * 1024);
+    splitSpin->setSuffix(" MB");
+    splitSpin->setSpecialValueText("No split");
+
+    threadSpin = new QSpinBox;
+    threadSpin->setRange(1, 64);
+    threadSpin->setToolTip("Callback queues used by the plugin's own subscriptions, one thread each");
+
+    prerollSpin = new QDoubleSpinBox;
+    prerollSpin->setRange(0.0, 600.0);
+    prerollSpin->setSuffix(" s");
+    prerollSpin->setToolTip("Messages received this long before Record was pressed are kept while armed");
+
+    quantizationSpin = new QSpinBox;
+    quantizationSpin->setRange(1, 30);
+    quantizationSpin->setSuffix(" bits");
+    quantizationSpin->setToolTip("XYZ precision of point clouds recorded with the draco encoding");
+
+    actionCombo = new QComboBox;
+    actionCombo->addItems(QStringList() << "Stop" << "Rotate");
+
+    auto gridLayout = new QGridLayout;
+    gridLayout->addWidget(new QLabel("Directories"), 0, 0);
+    gridLayout->addWidget(dirLine, 0, 1);
+    gridLayout->addWidget(browseButton, 0, 2);
+    gridLayout->addWidget(new QLabel("Min free space"), 1, 0);
+    gridLayout->addWidget(freeSpin, 1, 1);
+    gridLayout->addWidget(new QLabel("Split size"), 2, 0);
+    gridLayout->addWidget(splitSpin, 2, 1);
+    gridLayout->addWidget(new QLabel("When disk is full"), 3, 0);
+    gridLayout->addWidget(actionCombo, 3, 1);
+    gridLayout->addWidget(new QLabel("Point cloud quantization"), 4, 0);
+    gridLayout->addWidget(quantizationSpin, 4, 1);
+    gridLayout->addWidget(new QLabel("Callback threads"), 5, 0);
+    gridLayout->addWidget(threadSpin, 5, 1);
+    gridLayout->addWidget(new QLabel("Pre-roll"), 6, 0);
+    gridLayout->addWidget(prerollSpin, 6, 1);
+
+    buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok
+                                     | QDialogButtonBox::Cancel);
+
+    connect(buttonBox, &QDialogButtonBox::accepted, [&](){ accept(); });
+    connect(buttonBox, &QDialogButtonBox::rejected, [&](){ reject(); });
+
+    auto mainLayout = new QVBoxLayout;
+    mainLayout->addLayout(gridLayout);
+    mainLayout->addWidget(buttonBox);
+    mainLayout->addStretch();
+
+    setLayout(mainLayout);
+    setWindowTitle("Recorder Config");
+}
+
+void RecorderConfigDialog::browse()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, "Record Directory", dirLine->text());
+    if(!dir.isEmpty()) {
+        QStringList dirs = directories();
+        dirs << dir;
+        dirLine->setText(dirs.join(";"));
+    }
+}
+
 }
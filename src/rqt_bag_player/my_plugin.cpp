@@ -13,6 +13,7 @@ namespace rqt_bag_player {
 
 MyPlugin::MyPlugin()
     : rqt_gui_cpp::Plugin()
+    , widget_(nullptr)
 {
     // Constructor is called first before initPlugin function, needless to say.
 
@@ -25,9 +26,11 @@ void MyPlugin::initPlugin(qt_gui_cpp::PluginContext& context)
     // access standalone command line arguments
     QStringList argv = context.argv();
     // create QWidget
-    auto widget_ = new MainWindow;
+    widget_ = new MainWindow;
+    // all instances share the rqt node, so each gets its own services
     if(context.serialNumber() > 1) {
         widget_->setWindowTitle(widget_->windowTitle() + " (" + QString::number(context.serialNumber()) + ")");
+        widget_->setServiceNamespace("bag_player_" + QString::number(context.serialNumber()));
     }
     // add widget to the user interface
     context.addWidget(widget_);
@@ -35,23 +38,36 @@ void MyPlugin::initPlugin(qt_gui_cpp::PluginContext& context)
 
 void MyPlugin::shutdownPlugin()
 {
-    // TODO unregister all publishers here
+    if(widget_) {
+        widget_->shutdown();
+    }
 }
 
 void MyPlugin::saveSettings(qt_gui_cpp::Settings& plugin_settings, qt_gui_cpp::Settings& instance_settings) const
 {
-    // TODO save intrinsic configuration, usually using:
-    // instance_settings.setValue(k, v)
     (void) plugin_settings;
-    (void) instance_settings;
+    if(!widget_) {
+        return;
+    }
+
+    QVariantMap settings = widget_->saveSettings();
+    for(auto it = settings.begin(); it != settings.end(); ++it) {
+        instance_settings.setValue(it.key(), it.value());
+    }
 }
 
 void MyPlugin::restoreSettings(const qt_gui_cpp::Settings& plugin_settings, const qt_gui_cpp::Settings& instance_settings)
 {
-    // TODO restore intrinsic configuration, usually using:
-    // v = instance_settings.value(k)
     (void) plugin_settings;
-    (void) instance_settings;
+    if(!widget_) {
+        return;
+    }
+
+    QVariantMap settings;
+    for(auto& key : instance_settings.allKeys()) {
+        settings[key] = instance_settings.value(key);
+    }
+    widget_->restoreSettings(settings);
 }
 
 /*bool MyPlugin::hasConfiguration() const
@@ -0,0 +1,294 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/process_supervisor.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTimer>
+
+namespace rqt_bag_player {
+
+namespace {
+
+// rosbag record needs a moment to write the index of its last chunk
+const double ShutdownTimeout = 2.0;
+
+// rosbag record is a python wrapper around the recorder binary, each child
+// leads a process group of its own so signals reach its whole tree
+class GroupProcess : public QProcess
+{
+protected:
+    virtual void setupChildProcess() override
+    {
+        ::setpgid(0, 0);
+    }
+};
+
+}
+
+ProcessSupervisor::ProcessSupervisor(QObject* parent)
+    : QObject(parent)
+    , next_id(0)
+{
+    context = new QObject;
+    context->moveToThread(&worker);
+}
+
+ProcessSupervisor::~ProcessSupervisor()
+{
+    // nothing was ever started
+    if(!worker.isRunning()) {
+        delete context;
+        return;
+    }
+
+    stopAll(ShutdownTimeout);
+    call([&](){
+        for(auto& process : processes) {
+            delete process.second.process;
+        }
+        processes.clear();
+    });
+
+    worker.quit();
+    worker.wait();
+    delete context;
+}
+
+int ProcessSupervisor::start(const QString& program, const QStringList& arguments, const QRegularExpression& progressPattern)
+{
+    int id = -1;
+    call([&](){
+        // the process belongs to the worker thread, which reads its output
+        QProcess* process = new GroupProcess;
+        process->setProcessChannelMode(QProcess::MergedChannels);
+        process->start(program, arguments);
+        if(!process->waitForStarted()) {
+            delete process;
+            return;
+        }
+
+        id = next_id++;
+        processes[id] = Process{process, progressPattern, QString(), -1.0, -1, true, false};
+
+        connect(process, &QProcess::readyReadStandardOutput, context, [this, id](){ readOutput(id); });
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), context,
+            [this, id](int exitCode, QProcess::ExitStatus exitStatus){
+                auto it = processes.find(id);
+                if(it == processes.end()) {
+                    return;
+                }
+                readOutput(id);
+                Process& p = it->second;
+                p.exit_code = exitStatus == QProcess::NormalExit && !p.is_killed ? exitCode : -1;
+                p.is_running = false;
+                emit finished(id, p.exit_code);
+            });
+    });
+    return id;
+}
+
+void ProcessSupervisor::interrupt(const int& id, const double& timeout)
+{
+    call([&](){
+        auto it = processes.find(id);
+        if(it == processes.end() || !it->second.is_running) {
+            return;
+        }
+
+        // ros nodes shut down cleanly on SIGINT, rosbag record closes its bag,
+        // the group is signalled so grandchildren do not depend on forwarding
+        QProcess* process = it->second.process;
+        pid_t group = (pid_t)process->processId();
+        ::kill(-group, SIGINT);
+
+        int key = id;
+        QTimer::singleShot(qMax(0, (int)(timeout * 1000.0)), context, [this, key, process, group](){
+            auto it = processes.find(key);
+            if(it == processes.end() || it->second.process != process) {
+                return;
+            }
+
+            // a child that has exited may have left its own children behind
+            if(it->second.is_running || ::kill(-group, 0) == 0) {
+                it->second.is_killed = it->second.is_running;
+                ::kill(-group, SIGKILL);
+            }
+        });
+    });
+}
+
+void ProcessSupervisor::interruptAll(const double& timeout)
+{
+    for(auto& id : runningIds()) {
+        interrupt(id, timeout);
+    }
+}
+
+bool ProcessSupervisor::stop(const int& id, const double& timeout)
+{
+    interrupt(id, timeout);
+    return waitFor(std::vector<int>{id}, timeout);
+}
+
+bool ProcessSupervisor::stopAll(const double& timeout)
+{
+    // every child is interrupted before waiting, so they shut down in parallel
+    std::vector<int> ids = runningIds();
+    for(auto& id : ids) {
+        interrupt(id, timeout);
+    }
+    return waitFor(ids, timeout);
+}
+
+bool ProcessSupervisor::wait(const int& id, const double& timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while(isRunning(id)) {
+        if(timeout >= 0.0 && timer.elapsed() > timeout * 1000.0) {
+            return false;
+        }
+        QThread::msleep(5);
+    }
+    return true;
+}
+
+bool ProcessSupervisor::isRunning(const int& id) const
+{
+    bool result = false;
+    call([&](){
+        auto it = processes.find(id);
+        result = it != processes.end() && it->second.is_running;
+    });
+    return result;
+}
+
+bool ProcessSupervisor::hasRunning() const
+{
+    bool result = false;
+    call([&](){
+        for(auto& process : processes) {
+            result = result || process.second.is_running;
+        }
+    });
+    return result;
+}
+
+int ProcessSupervisor::exitCode(const int& id) const
+{
+    int result = -1;
+    call([&](){
+        auto it = processes.find(id);
+        if(it != processes.end()) {
+            result = it->second.exit_code;
+        }
+    });
+    return result;
+}
+
+double ProcessSupervisor::progress(const int& id) const
+{
+    double result = -1.0;
+    call([&](){
+        auto it = processes.find(id);
+        if(it != processes.end()) {
+            result = it->second.progress;
+        }
+    });
+    return result;
+}
+
+void ProcessSupervisor::clearFinished()
+{
+    call([&](){
+        for(auto it = processes.begin(); it != processes.end();) {
+            if(!it->second.is_running) {
+                delete it->second.process;
+                it = processes.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    });
+}
+
+std::vector<int> ProcessSupervisor::runningIds() const
+{
+    std::vector<int> ids;
+    call([&](){
+        for(auto& process : processes) {
+            if(process.second.is_running) {
+                ids.push_back(process.first);
+            }
+        }
+    });
+    return ids;
+}
+
+void ProcessSupervisor::call(const std::function<void()>& function) const
+{
+    std::call_once(worker_started, [this](){ worker.start(); });
+    if(QThread::currentThread() == &worker) {
+        function();
+    } else {
+        QMetaObject::invokeMethod(context, function, Qt::BlockingQueuedConnection);
+    }
+}
+
+void ProcessSupervisor::readOutput(const int& id)
+{
+    auto it = processes.find(id);
+    if(it == processes.end()) {
+        return;
+    }
+
+    // progress bars redraw their line with \r, only complete lines are parsed
+    Process& p = it->second;
+    p.output += QString::fromLocal8Bit(p.process->readAllStandardOutput());
+    QStringList lines = p.output.split(QRegularExpression("[\r\n]"));
+    p.output = lines.takeLast();
+
+    if(p.pattern.pattern().isEmpty()) {
+        return;
+    }
+    for(auto& line : lines) {
+        QRegularExpressionMatch match = p.pattern.match(line);
+        if(match.hasMatch()) {
+            double progress = match.captured(1).toDouble();
+            if(progress != p.progress) {
+                p.progress = progress;
+                emit progressChanged(id, progress);
+            }
+        }
+    }
+}
+
+bool ProcessSupervisor::waitFor(const std::vector<int>& ids, const double& timeout)
+{
+    // a killed process needs a moment to be reaped
+    QElapsedTimer timer;
+    timer.start();
+    for(auto& id : ids) {
+        double remaining = timeout + 1.0 - timer.elapsed() / 1000.0;
+        wait(id, qMax(0.0, remaining));
+    }
+
+    bool result = true;
+    call([&](){
+        for(auto& id : ids) {
+            auto it = processes.find(id);
+            if(it != processes.end() && (it->second.is_running || it->second.is_killed)) {
+                result = false;
+            }
+        }
+    });
+    return result;
+}
+
+}
@@ -0,0 +1,88 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/recorder.h"
+
+#include <ros/ros.h>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+
+namespace rqt_bag_player {
+
+Recorder::Recorder()
+{
+
+}
+
+bool Recorder::record(const QString& fileName, const QStringList& topics, const QStringList& options, const int& splitSize)
+{
+    QStringList arguments;
+    arguments << "record";
+    arguments << "-O" << fileName;
+    if(splitSize > 0) {
+        arguments << "--split" << QString("--size=%1").arg(splitSize);
+    }
+    arguments << options;
+    arguments << topics;
+
+    if(startNode("rosbag", arguments, "record").isEmpty()) {
+        return false;
+    }
+    fileNames << fileName;
+    return true;
+}
+
+QString Recorder::startNode(const QString& program, const QStringList& arguments, const QString& prefix)
+{
+    QString node = QString("%1_%2_%3").arg(prefix).arg(ros::Time::now().toNSec()).arg(ids.size());
+    int id = processes.start(program, QStringList(arguments) << QString("__name:=%1").arg(node));
+    if(id < 0) {
+        ROS_WARN("Failed to start %s", program.toStdString().c_str());
+        return QString();
+    }
+    ids.push_back(id);
+    return node;
+}
+
+bool Recorder::stop(const double& timeout, const bool& wait)
+{
+    // the children are signalled directly, no round trip through the master
+    bool result = true;
+    if(wait) {
+        result = processes.stopAll(timeout);
+        processes.clearFinished();
+    } else {
+        processes.interruptAll(timeout);
+    }
+    ids.clear();
+    fileNames.clear();
+    return result;
+}
+
+bool Recorder::waitForBags(const QStringList& bags, const bool& active, const double& timeout)
+{
+    QDateTime deadline = QDateTime::currentDateTime().addMSecs(timeout * 1000.0);
+    while(true) {
+        bool done = true;
+        for(auto& bag : bags) {
+            QFileInfo info(bag);
+            bool is_active = !info.dir().entryList(QStringList() << info.completeBaseName() + "*.bag.active", QDir::Files).isEmpty();
+            if(active ? !(is_active || info.exists()) : is_active) {
+                done = false;
+            }
+        }
+        if(done) {
+            return true;
+        }
+        if(QDateTime::currentDateTime() >= deadline) {
+            return false;
+        }
+        QThread::msleep(50);
+    }
+}
+
+}
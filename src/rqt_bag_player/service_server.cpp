@@ -0,0 +1,131 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/service_server.h"
+
+#include <rqt_bag_player/ExportBag.h>
+#include <rqt_bag_player/LoadBag.h>
+#include <rqt_bag_player/Seek.h>
+#include <rqt_bag_player/SetRate.h>
+#include <rqt_bag_player/Step.h>
+#include <std_srvs/SetBool.h>
+
+namespace rqt_bag_player {
+
+namespace {
+
+template<class Response>
+bool unavailable(Response& res)
+{
+    res.success = false;
+    res.message = "Not supported";
+    return true;
+}
+
+}
+
+ServiceServer::ServiceServer()
+{
+
+}
+
+ServiceServer::~ServiceServer()
+{
+    stop();
+}
+
+bool ServiceServer::start(const std::string& ns, const Handlers& handlers)
+{
+    stop();
+    this->handlers = handlers;
+
+    ros::NodeHandle n(ns);
+    n.setCallbackQueue(&queue);
+
+    servers.push_back(n.advertiseService<LoadBag::Request, LoadBag::Response>("load_bag",
+        [this](LoadBag::Request& req, LoadBag::Response& res){
+            if(!this->handlers.load) {
+                return unavailable(res);
+            }
+            res.success = this->handlers.load(req.files, res.message);
+            return true;
+        }));
+    servers.push_back(n.advertiseService<std_srvs::SetBool::Request, std_srvs::SetBool::Response>("play",
+        [this](std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res){
+            if(!this->handlers.play) {
+                return unavailable(res);
+            }
+            res.success = this->handlers.play(req.data, res.message);
+            return true;
+        }));
+    servers.push_back(n.advertiseService<Seek::Request, Seek::Response>("seek",
+        [this](Seek::Request& req, Seek::Response& res){
+            if(!this->handlers.seek) {
+                return unavailable(res);
+            }
+            res.success = this->handlers.seek(req.time, res.message);
+            return true;
+        }));
+    servers.push_back(n.advertiseService<SetRate::Request, SetRate::Response>("set_rate",
+        [this](SetRate::Request& req, SetRate::Response& res){
+            if(!this->handlers.setRate) {
+                return unavailable(res);
+            }
+            res.success = this->handlers.setRate(req.rate, res.message);
+            return true;
+        }));
+    servers.push_back(n.advertiseService<Step::Request, Step::Response>("step",
+        [this](Step::Request& req, Step::Response& res){
+            if(!this->handlers.step) {
+                return unavailable(res);
+            }
+            res.success = this->handlers.step(req.count, res.message);
+            return true;
+        }));
+    servers.push_back(n.advertiseService<std_srvs::SetBool::Request, std_srvs::SetBool::Response>("record",
+        [this](std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res){
+            if(!this->handlers.record) {
+                return unavailable(res);
+            }
+            res.success = this->handlers.record(req.data, res.message);
+            return true;
+        }));
+    servers.push_back(n.advertiseService<ExportBag::Request, ExportBag::Response>("export_bag",
+        [this](ExportBag::Request& req, ExportBag::Response& res){
+            if(!this->handlers.exportBag) {
+                return unavailable(res);
+            }
+            res.success = this->handlers.exportBag(req.file, req.topics, res.message);
+            return true;
+        }));
+
+    // roscpp hands out an empty server for a name taken in this node
+    for(auto& server : servers) {
+        if(!server) {
+            stop();
+            return false;
+        }
+    }
+
+    spinner.reset(new ros::AsyncSpinner(1, &queue));
+    spinner->start();
+    return true;
+}
+
+void ServiceServer::stop()
+{
+    // the spinner is stopped first so no handler runs while the
+    // servers are shut down
+    if(spinner) {
+        spinner->stop();
+        spinner.reset();
+    }
+    for(auto& server : servers) {
+        server.shutdown();
+    }
+    servers.clear();
+    queue.clear();
+}
+
+}
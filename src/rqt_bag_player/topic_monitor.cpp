@@ -0,0 +1,454 @@
+/**
+   @author Kenta Suzuki
+*/
+
+#include "rqt_bag_player/topic_monitor.h"
+
+#include <rosbag/view.h>
+#include <roslz4/lz4s.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+
+namespace rqt_bag_player {
+
+namespace {
+
+const double WindowLength = 2.0;
+const double SampleInterval = 1.0;
+
+// subscriptions are polled this often while waiting for their publishers
+const double ConnectInterval = 0.01;
+
+}
+
+TopicMonitor::TopicMonitor()
+    : next_group(0)
+    , thread_count(1)
+    , preroll(0.0)
+    , is_capturing(false)
+{
+
+}
+
+TopicMonitor::~TopicMonitor()
+{
+    shutdown();
+}
+
+void TopicMonitor::shutdown()
+{
+    clear();
+    stopCapture();
+    for(auto& group : groups) {
+        group->spinner->stop();
+    }
+    groups.clear();
+}
+
+void TopicMonitor::setThreadCount(const int& count)
+{
+    if(count < 1 || count == thread_count) {
+        return;
+    }
+    thread_count = count;
+    if(groups.empty()) {
+        return;
+    }
+
+    // the subscriptions are bound to the old queues, move them over
+    std::vector<std::string> topics;
+    std::map<std::string, std::string> transports;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& pair : statistics) {
+            topics.push_back(pair.first);
+            transports[pair.first] = pair.second->transport;
+        }
+    }
+    clear();
+
+    for(auto& group : groups) {
+        group->spinner->stop();
+    }
+    groups.clear();
+
+    setTopics(topics, transports);
+}
+
+void TopicMonitor::startSpinners()
+{
+    for(int i = 0; i < thread_count; ++i) {
+        groups.emplace_back(new Group);
+        groups.back()->spinner.reset(new ros::AsyncSpinner(1, &groups.back()->queue));
+        groups.back()->spinner->start();
+    }
+    next_group = 0;
+}
+
+void TopicMonitor::setTopics(const std::vector<std::string>& topics,
+    const std::map<std::string, std::string>& transports)
+{
+    std::set<std::string> names(topics.begin(), topics.end());
+    std::vector<ros::Subscriber> subs;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto it = statistics.begin(); it != statistics.end(); ) {
+            auto transport = transports.find(it->first);
+            std::string name = transport == transports.end() ? "" : transport->second;
+            if(names.count(it->first) == 0 || it->second->transport != name) {
+                subs.push_back(it->second->sub);
+                it = statistics.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // shutdown waits for running callbacks
+    for(auto& sub : subs) {
+        sub.shutdown();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& topic : names) {
+        if(statistics.count(topic) == 0) {
+            StatisticsPtr stat = std::make_shared<Statistics>();
+            auto transport = transports.find(topic);
+            stat->transport = transport == transports.end() ? "" : transport->second;
+            stat->window_start = ros::WallTime::now();
+            stat->window_bytes = 0;
+            stat->bandwidth = 0.0;
+            stat->sample_size = 0;
+            subscribe(topic, stat);
+            statistics[topic] = stat;
+        }
+    }
+}
+
+bool TopicMonitor::waitForPublishers(const double& timeout)
+{
+    ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+    while(true) {
+        bool is_connected = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto& pair : statistics) {
+                if(pair.second->sub.getNumPublishers() == 0) {
+                    is_connected = false;
+                    break;
+                }
+            }
+        }
+        if(is_connected) {
+            return true;
+        }
+        if(ros::WallTime::now() >= deadline) {
+            return false;
+        }
+        ros::WallDuration(ConnectInterval).sleep();
+    }
+}
+
+void TopicMonitor::clear()
+{
+    std::vector<ros::Subscriber> subs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& pair : statistics) {
+            subs.push_back(pair.second->sub);
+        }
+        statistics.clear();
+    }
+
+    for(auto& sub : subs) {
+        sub.shutdown();
+    }
+}
+
+double TopicMonitor::bandwidth(const std::string& topic) const
+{
+    StatisticsPtr stat = find(topic);
+    if(!stat) {
+        return 0.0;
+    }
+
+    std::lock_guard<std::mutex> lock(stat->mutex);
+    if(stat->bandwidth > 0.0) {
+        return stat->bandwidth;
+    }
+
+    // no full window yet, use what has been received so far
+    double elapsed = (ros::WallTime::now() - stat->window_start).toSec();
+    return elapsed > 0.0 ? stat->window_bytes / elapsed : 0.0;
+}
+
+double TopicMonitor::compressionRatio(const std::string& topic) const
+{
+    StatisticsPtr stat = find(topic);
+    if(!stat) {
+        return 0.0;
+    }
+
+    BufferPool::BufferPtr sample;
+    size_t sample_size = 0;
+    {
+        std::lock_guard<std::mutex> lock(stat->mutex);
+        if(stat->sample_size == 0) {
+            return 0.0;
+        }
+        sample_size = stat->sample_size;
+        sample = pool.allocate(sample_size);
+        std::copy(stat->sample.get(), stat->sample.get() + sample_size, sample.get());
+    }
+
+    // block size id 6 is what rosbag uses for its lz4 chunks
+    BufferPool::BufferPtr output = pool.allocate(sample_size * 2 + 64);
+    unsigned int output_size = BufferPool::capacity(output.get());
+    int result = roslz4_buffToBuffCompress((char*)sample.get(), sample_size,
+        (char*)output.get(), &output_size, 6);
+    if(result != ROSLZ4_OK || output_size == 0) {
+        return 0.0;
+    }
+    return (double)sample_size / output_size;
+}
+
+void TopicMonitor::subscribe(const std::string& topic, const StatisticsPtr& stat)
+{
+    ros::TransportHints hints;
+    if(stat->transport == "tcpnodelay") {
+        hints.tcpNoDelay();
+    } else if(stat->transport == "udp") {
+        hints.unreliable().reliable();
+    }
+
+    // no threads are kept for a monitor nobody uses
+    if(groups.empty()) {
+        startSpinners();
+    }
+
+    // topics are spread over the queues so a slow one only delays its own group
+    Group& group = *groups[next_group++ % groups.size()];
+
+    std::weak_ptr<Statistics> weak = stat;
+    boost::function<void(const topic_tools::ShapeShifter::ConstPtr&)> cb =
+        [this, topic, weak](const topic_tools::ShapeShifter::ConstPtr& msg){
+            StatisticsPtr stat = weak.lock();
+            if(stat) {
+                callback(topic, *stat, msg);
+            }
+        };
+
+    ros::SubscribeOptions ops;
+    ops.init<topic_tools::ShapeShifter>(topic, 10, cb);
+    ops.transport_hints = hints;
+    ops.callback_queue = &group.queue;
+    stat->sub = n.subscribe(ops);
+}
+
+void TopicMonitor::callback(const std::string& topic, Statistics& stat, const topic_tools::ShapeShifter::ConstPtr& msg)
+{
+    if(is_capturing) {
+        std::lock_guard<std::mutex> lock(capture_mutex);
+        if(capture) {
+            capture->write(topic, now(), *msg);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(stat.mutex);
+    stat.window_bytes += msg->size();
+
+    ros::WallTime now = ros::WallTime::now();
+    double seconds = preroll;
+    if(seconds > 0.0 && !is_capturing) {
+        if(stat.datatype.empty()) {
+            stat.datatype = msg->getDataType();
+            stat.md5sum = msg->getMD5Sum();
+            stat.definition = msg->getMessageDefinition();
+        }
+
+        Message message;
+        message.stamp = this->now();
+        message.data = pool.allocate(msg->size());
+        message.size = msg->size();
+        ros::serialization::OStream stream(message.data.get(), message.size);
+        msg->write(stream);
+        stat.ring.push_back(std::move(message));
+
+        ros::Time oldest = stat.ring.back().stamp - ros::Duration(seconds);
+        while(!stat.ring.empty() && stat.ring.front().stamp < oldest) {
+            stat.ring.pop_front();
+        }
+    }
+    if(stat.sample_size == 0 || (now - stat.sample_time).toSec() >= SampleInterval) {
+        // the previous sample goes back to the pool, a buffer of the same size class is reused
+        stat.sample.reset();
+        stat.sample = pool.allocate(msg->size());
+        stat.sample_size = msg->size();
+        ros::serialization::OStream stream(stat.sample.get(), stat.sample_size);
+        msg->write(stream);
+        stat.sample_time = now;
+    }
+
+    double elapsed = (now - stat.window_start).toSec();
+    if(elapsed >= WindowLength) {
+        stat.bandwidth = stat.window_bytes / elapsed;
+        stat.window_bytes = 0;
+        stat.window_start = now;
+    }
+}
+
+void TopicMonitor::setClock(const std::function<ros::Time()>& clock)
+{
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    this->clock = clock;
+}
+
+void TopicMonitor::setPreroll(const double& seconds)
+{
+    preroll = seconds;
+    if(seconds <= 0.0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& pair : statistics) {
+            std::lock_guard<std::mutex> statLock(pair.second->mutex);
+            pair.second->ring.clear();
+        }
+    }
+}
+
+bool TopicMonitor::startCapture(const std::string& fileName, const bool& withPreroll)
+{
+    stopCapture();
+
+    // messages arriving meanwhile wait on the lock and are appended after the ring
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    capture.reset(new rosbag::Bag);
+    try {
+        capture->open(fileName, rosbag::bagmode::Write);
+    } catch(rosbag::BagException& ex) {
+        ROS_ERROR("Failed to open %s: %s", fileName.c_str(), ex.what());
+        capture.reset();
+        return false;
+    }
+    is_capturing = true;
+
+    struct Entry
+    {
+        std::string topic;
+        StatisticsPtr stat;
+        Message message;
+    };
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> mapLock(mutex);
+        for(auto& pair : statistics) {
+            std::lock_guard<std::mutex> statLock(pair.second->mutex);
+            if(withPreroll) {
+                for(auto& message : pair.second->ring) {
+                    entries.push_back(Entry{ pair.first, pair.second, std::move(message) });
+                }
+            }
+            pair.second->ring.clear();
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b){ return a.message.stamp < b.message.stamp; });
+
+    topic_tools::ShapeShifter shifter;
+    for(auto& entry : entries) {
+        shifter.morph(entry.stat->md5sum, entry.stat->datatype, entry.stat->definition, "");
+        ros::serialization::IStream stream(entry.message.data.get(), entry.message.size);
+        shifter.read(stream);
+        capture->write(entry.topic, entry.message.stamp, shifter);
+    }
+    return true;
+}
+
+void TopicMonitor::stopCapture()
+{
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    if(capture) {
+        capture->close();
+        capture.reset();
+    }
+    is_capturing = false;
+}
+
+bool TopicMonitor::trimCapture(const std::string& fileName, const std::vector<std::string>& bags)
+{
+    // only the indexes of the recorded bags are read
+    std::map<std::string, ros::Time> firsts;
+    for(auto& name : bags) {
+        rosbag::Bag bag;
+        try {
+            bag.open(name, rosbag::bagmode::Read);
+        } catch(rosbag::BagException&) {
+            std::string base = name.size() > 4 ? name.substr(0, name.size() - 4) : name;
+            try {
+                bag.open(base + "_0.bag", rosbag::bagmode::Read);
+            } catch(rosbag::BagException& ex) {
+                ROS_WARN("Failed to read %s: %s", name.c_str(), ex.what());
+                continue;
+            }
+        }
+
+        rosbag::View view(bag);
+        for(auto& info : view.getConnections()) {
+            rosbag::View topicView(bag, rosbag::TopicQuery(info->topic));
+            ros::Time first = topicView.getBeginTime();
+            auto it = firsts.find(info->topic);
+            if(it == firsts.end() || first < it->second) {
+                firsts[info->topic] = first;
+            }
+        }
+    }
+    if(firsts.empty()) {
+        return true;
+    }
+
+    // the capture is a few seconds long, it is rewritten next to itself
+    std::string trimmedName = fileName + ".trim";
+    size_t dropped = 0;
+    try {
+        rosbag::Bag input(fileName, rosbag::bagmode::Read);
+        rosbag::Bag output(trimmedName, rosbag::bagmode::Write);
+        rosbag::View view(input);
+        for(const rosbag::MessageInstance& m : view) {
+            auto it = firsts.find(m.getTopic());
+            if(it != firsts.end() && m.getTime() >= it->second) {
+                ++dropped;
+                continue;
+            }
+            output.write(m.getTopic(), m.getTime(), m, m.getConnectionHeader());
+        }
+    } catch(rosbag::BagException& ex) {
+        ROS_ERROR("Failed to trim %s: %s", fileName.c_str(), ex.what());
+        std::remove(trimmedName.c_str());
+        return false;
+    }
+
+    if(std::rename(trimmedName.c_str(), fileName.c_str()) != 0) {
+        ROS_ERROR("Failed to replace %s", fileName.c_str());
+        std::remove(trimmedName.c_str());
+        return false;
+    }
+    ROS_DEBUG("Dropped %lu messages recorded twice from %s", (unsigned long)dropped, fileName.c_str());
+    return true;
+}
+
+ros::Time TopicMonitor::now() const
+{
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    return clock ? clock() : ros::Time::now();
+}
+
+TopicMonitor::StatisticsPtr TopicMonitor::find(const std::string& topic) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = statistics.find(topic);
+    return it == statistics.end() ? StatisticsPtr() : it->second;
+}
+
+}